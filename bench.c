@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "ringbuf.h"
+#include "ringbuf_static.h"
+#include "fsm.h"
+
+/* Output is CSV, one row per case:
+
+   bench,mode,buf_size,chunk,autocommit,pattern,ops,ns_per_op,mb_per_s,p50_ns,p99_ns,p999_ns
+
+   Throughput rows leave the percentile columns empty, latency rows leave
+   ns_per_op/mb_per_s empty. For spsc_threads* rows `pattern` is the
+   ringbuffer_t layout (packed or cacheline). ./bench [MiB per case],
+   default 4. */
+
+#define BENCH_CHUNK_MAX   (64*1024)
+#define BENCH_LAT_SAMPLES (200*1000)
+
+static size_t bench_bytes = 4*1024*1024;
+
+#ifdef RINGBUF_CACHELINE
+static const char *bench_layout = "cacheline";
+#else
+static const char *bench_layout = "packed";
+#endif
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static const char *bench_mode_name(uint8_t mode) {
+    switch( mode ) {
+        case 0:                                         return "default";
+        case RINGBUF_MODE_POW2:                         return "pow2";
+        case RINGBUF_MODE_SPSC:                         return "spsc";
+        case RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2:     return "spsc_pow2";
+    }
+    return "other";
+}
+
+static void bench_header(void) {
+    printf("bench,mode,buf_size,chunk,autocommit,pattern,ops,ns_per_op,mb_per_s,p50_ns,p99_ns,p999_ns\n");
+}
+
+/* write one chunk, read one chunk, repeat. "wrap" shifts the positions by
+   half a chunk first, so every pass over be splits the copy in two */
+static void bench_rw(uint8_t mode, size_t buf_size, size_t chunk, int autocommit, int wrap) {
+    static uint8_t src[BENCH_CHUNK_MAX];
+    static uint8_t dst[BENCH_CHUNK_MAX];
+    uint8_t *mem = (uint8_t*)malloc(RINGBUF_ALLOC_SIZE(buf_size));
+    ringbuffer_t *rb = ringbuffer_alloc_mode(RINGBUF_ALLOC_SIZE(buf_size), mem, mode);
+    size_t ops = bench_bytes / chunk;
+    size_t i = 0, moved = 0;
+    uint64_t t0 = 0, t1 = 0;
+    double ns = 0;
+
+    ringbuffer_update_flags(rb, autocommit, RINGBUF_AUTOCOMMIT);
+
+    if( wrap ) {
+        ringbuffer_write(rb, src, chunk / 2 + 1);
+        ringbuffer_commit(rb);
+        ringbuffer_read(rb, dst, chunk / 2 + 1);
+    }
+
+    t0 = bench_now_ns();
+    for(i = 0; i < ops; i++) {
+        moved += ringbuffer_write(rb, src, chunk);
+        if( !autocommit ) ringbuffer_commit(rb);
+        moved += ringbuffer_read(rb, dst, chunk);
+    }
+    t1 = bench_now_ns();
+
+    if( moved != 2 * ops * chunk ) {
+        fprintf(stderr, "bench_rw: moved %zu, expected %zu\n", moved, 2 * ops * chunk);
+    }
+
+    /* one op = one write + one read */
+    ns = (double)(t1 - t0);
+    printf("rw,%s,%zu,%zu,%d,%s,%zu,%.2f,%.1f,,,\n",
+           bench_mode_name(mode), buf_size, chunk, autocommit, wrap ? "wrap" : "aligned",
+           ops, ns / ops, (double)(ops * chunk) * 1000.0 / ns);
+
+    free(mem);
+}
+
+/* byte at a time protocol: ringbuffer_write/read of 1 vs putc/getc */
+static void bench_bytes_rw(uint8_t mode, int use_putc) {
+    uint8_t *mem = (uint8_t*)malloc(RINGBUF_ALLOC_SIZE(4096));
+    ringbuffer_t *rb = ringbuffer_alloc_mode(RINGBUF_ALLOC_SIZE(4096), mem, mode);
+    size_t ops = bench_bytes;
+    size_t i = 0, moved = 0;
+    uint8_t b = 0;
+    uint64_t t0 = 0, t1 = 0;
+    double ns = 0;
+
+    t0 = bench_now_ns();
+    for(i = 0; i < ops; i++) {
+        if( use_putc ) {
+            moved += ringbuffer_putc(rb, (uint8_t)i);
+            moved += ringbuffer_getc(rb) >= 0;
+        } else {
+            b = (uint8_t)i;
+            moved += ringbuffer_write(rb, &b, 1);
+            moved += ringbuffer_read(rb, &b, 1);
+        }
+    }
+    t1 = bench_now_ns();
+
+    if( moved != 2 * ops ) {
+        fprintf(stderr, "bench_bytes_rw: moved %zu, expected %zu\n", moved, 2 * ops);
+    }
+
+    ns = (double)(t1 - t0);
+    printf("bytes,%s,4096,1,1,%s,%zu,%.2f,%.1f,,,\n",
+           bench_mode_name(mode), use_putc ? "putc" : "write",
+           ops, ns / ops, (double)ops * 1000.0 / ns);
+
+    free(mem);
+}
+
+/* '\n' framed lines of `chunk` bytes: getc until the delimiter vs
+   ringbuffer_read_until + consume */
+static void bench_lines(size_t chunk, int use_find) {
+    static uint8_t line[BENCH_CHUNK_MAX];
+    uint8_t *mem = (uint8_t*)malloc(RINGBUF_ALLOC_SIZE(65536));
+    ringbuffer_t *rb = ringbuffer_alloc(RINGBUF_ALLOC_SIZE(65536), mem);
+    ringbuffer_span_t span[2];
+    size_t ops = bench_bytes / chunk;
+    size_t i = 0, n = 0, lines = 0;
+    uint64_t t0 = 0, t1 = 0;
+    double ns = 0;
+
+    memset(line, 'x', chunk - 1);
+    line[chunk - 1] = '\n';
+
+    t0 = bench_now_ns();
+    for(i = 0; i < ops; i++) {
+        ringbuffer_write(rb, line, chunk);
+        if( use_find ) {
+            n = ringbuffer_read_until(rb, '\n', span);
+            ringbuffer_read_consume(rb, n);
+            lines += n != 0;
+        } else {
+            int c = 0;
+            while( (c = ringbuffer_getc(rb)) >= 0 && c != '\n' );
+            lines += c == '\n';
+        }
+    }
+    t1 = bench_now_ns();
+
+    if( lines != ops ) {
+        fprintf(stderr, "bench_lines: %zu lines, expected %zu\n", lines, ops);
+    }
+
+    ns = (double)(t1 - t0);
+    printf("lines,default,65536,%zu,1,%s,%zu,%.2f,%.1f,,,\n",
+           chunk, use_find ? "read_until" : "getc",
+           ops, ns / ops, (double)(ops * chunk) * 1000.0 / ns);
+
+    free(mem);
+}
+
+/* HTTP request header block parsed two ways: the switch form of fsm.h
+   stepped once per byte, and FSM_SPAN over the whole peeked span */
+
+typedef struct bench_http_t_ {
+    size_t headers;
+    size_t messages;
+} bench_http_t;
+
+FSM_DECLARE(bench_hsw, BH_LINE)
+    FSM_STATE_DECL(BH_NAME)
+    FSM_STATE_DECL(BH_VALUE)
+    FSM_STATE_DECL(BH_LF)
+    FSM_STATE_DECL(BH_END)
+FSM_CTX_DECLARE_END(bench_hsw, 1)
+
+static inline void bench_hsw_step(bench_hsw__ctx__t *ctx, bench_http_t *h, uint8_t c) {
+    FSM_CTX_BEGIN(bench_hsw, ctx)
+        FSM_STATE_BEGIN(BH_LINE)
+            FSM_TRANS(c == '\r' ? FSM_S(BH_END) : FSM_S(BH_NAME));
+        FSM_STATE_END(FSM_CURRENT_STATE)
+        FSM_STATE_BEGIN(BH_NAME)
+            if( c == ':' ) FSM_TRANS(FSM_S(BH_VALUE));
+        FSM_STATE_END(FSM_CURRENT_STATE)
+        FSM_STATE_BEGIN(BH_VALUE)
+            if( c == '\r' ) {
+                h->headers++;
+                FSM_TRANS(FSM_S(BH_LF));
+            }
+        FSM_STATE_END(FSM_CURRENT_STATE)
+        FSM_STATE_BEGIN(BH_LF)
+        FSM_STATE_END(FSM_S(BH_LINE))
+        FSM_STATE_BEGIN(BH_END)
+            h->messages++;
+        FSM_STATE_END(FSM_S(BH_LINE))
+    FSM_CTX_END(bench_hsw)
+}
+
+#define BENCH_HSP_STATES(X) X(BS_LINE) X(BS_NAME) X(BS_VALUE) X(BS_LF) X(BS_END)
+
+FSM_SPAN_DECLARE(bench_hsp, BENCH_HSP_STATES, 1)
+
+static size_t bench_hsp_feed(bench_hsp__ctx__t *ctx, bench_http_t *h, const uint8_t *p, size_t len) {
+    size_t used = 0;
+    FSM_SPAN_BEGIN(bench_hsp, BENCH_HSP_STATES, ctx, p, len)
+        FSM_SPAN_STATE(BS_LINE)
+            if( FSM_SPAN_BYTE == '\r' ) FSM_SPAN_GOTO(BS_END);
+            FSM_SPAN_GOTO(BS_NAME);
+        FSM_SPAN_STATE(BS_NAME)
+            if( FSM_SPAN_BYTE == ':' ) FSM_SPAN_GOTO(BS_VALUE);
+            FSM_SPAN_GOTO(BS_NAME);
+        FSM_SPAN_STATE(BS_VALUE)
+            if( FSM_SPAN_BYTE == '\r' ) {
+                h->headers++;
+                FSM_SPAN_GOTO(BS_LF);
+            }
+            FSM_SPAN_GOTO(BS_VALUE);
+        FSM_SPAN_STATE(BS_LF)
+            FSM_SPAN_GOTO(BS_LINE);
+        FSM_SPAN_STATE(BS_END)
+            h->messages++;
+            FSM_SPAN_GOTO(BS_LINE);
+    FSM_SPAN_END(bench_hsp, used)
+    return used;
+}
+
+static void bench_fsm(int span_form) {
+    static const char req[] =
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/118.0\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    size_t len = sizeof(req) - 1;
+    uint8_t *mem = (uint8_t*)malloc(RINGBUF_ALLOC_SIZE(4096));
+    ringbuffer_t *rb = ringbuffer_alloc(RINGBUF_ALLOC_SIZE(4096), mem);
+    ringbuffer_span_t span[2];
+    bench_hsw__ctx__t sw;
+    bench_hsp__ctx__t sp;
+    bench_http_t h = { 0, 0 };
+    size_t ops = bench_bytes / len;
+    size_t i = 0, k = 0, j = 0;
+    uint64_t t0 = 0, t1 = 0;
+    double ns = 0;
+
+    FSM_CTX_INIT(&sw);
+    FSM_CTX_INIT(&sp);
+
+    t0 = bench_now_ns();
+    for(i = 0; i < ops; i++) {
+        ringbuffer_write(rb, (const uint8_t*)req, len);
+        ringbuffer_read_peek(rb, len, span);
+        for(k = 0; k < 2; k++) {
+            if( span_form ) {
+                bench_hsp_feed(&sp, &h, span[k].ptr, span[k].len);
+            } else {
+                for(j = 0; j < span[k].len; j++) bench_hsw_step(&sw, &h, span[k].ptr[j]);
+            }
+        }
+        ringbuffer_read_consume(rb, len);
+    }
+    t1 = bench_now_ns();
+
+    if( h.messages != ops || h.headers != ops * 6 ) {
+        fprintf(stderr, "bench_fsm: %zu messages, %zu headers, expected %zu\n", h.messages, h.headers, ops);
+    }
+
+    ns = (double)(t1 - t0);
+    printf("fsm,default,4096,%zu,1,%s,%zu,%.2f,%.1f,,,\n",
+           len, span_form ? "span" : "switch",
+           ops, ns / ops, (double)(ops * len) * 1000.0 / ns);
+
+    free(mem);
+}
+
+RINGBUF_DEFINE(bench_static, uint8_t, 4096)
+
+/* same loop as bench_rw over the compile time ring from ringbuf_static.h */
+static void bench_static_rw(size_t chunk) {
+    static uint8_t src[BENCH_CHUNK_MAX];
+    static uint8_t dst[BENCH_CHUNK_MAX];
+    static bench_static_t rb;
+    size_t ops = bench_bytes / chunk;
+    size_t i = 0, moved = 0;
+    uint64_t t0 = 0, t1 = 0;
+    double ns = 0;
+
+    bench_static_init(&rb);
+
+    t0 = bench_now_ns();
+    for(i = 0; i < ops; i++) {
+        moved += bench_static_write(&rb, src, chunk);
+        moved += bench_static_read(&rb, dst, chunk);
+    }
+    t1 = bench_now_ns();
+
+    if( moved != 2 * ops * chunk ) {
+        fprintf(stderr, "bench_static_rw: moved %zu, expected %zu\n", moved, 2 * ops * chunk);
+    }
+
+    ns = (double)(t1 - t0);
+    printf("rw,static,4096,%zu,1,aligned,%zu,%.2f,%.1f,,,\n",
+           chunk, ops, ns / ops, (double)(ops * chunk) * 1000.0 / ns);
+}
+
+#define BENCH_BATCH 64
+
+typedef struct bench_spsc_t_ {
+    ringbuffer_t *rb;
+    size_t       chunk;
+    size_t       ops;
+    int          batch;
+} bench_spsc_t;
+
+static void *bench_spsc_producer(void *arg) {
+    static uint8_t src[BENCH_CHUNK_MAX];
+    bench_spsc_t *ctx = (bench_spsc_t*)arg;
+    size_t i = 0, n = 0;
+    for(i = 0; i < ctx->ops; ) {
+        if( ctx->batch ) ringbuffer_write_batch_begin(ctx->rb);
+        for(n = 0; n < (ctx->batch ? BENCH_BATCH : 1) && i < ctx->ops; n++) {
+            if( ringbuffer_write(ctx->rb, src, ctx->chunk) != ctx->chunk ) break;
+            i++;
+        }
+        if( ctx->batch ) ringbuffer_write_batch_end(ctx->rb);
+        if( !n ) sched_yield();
+    }
+    return 0;
+}
+
+/* producer and consumer on two threads, fixed size writes/reads.
+   This is the case RINGBUF_CACHELINE is for, compare bench vs bench_cacheline.
+   With `batch` both sides publish their counter once per BENCH_BATCH ops */
+static void bench_spsc_threads(uint8_t mode, size_t buf_size, size_t chunk, int batch) {
+    static uint8_t dst[BENCH_CHUNK_MAX];
+    uint8_t *mem = (uint8_t*)malloc(RINGBUF_ALLOC_SIZE(buf_size));
+    bench_spsc_t ctx;
+    pthread_t producer;
+    size_t i = 0, n = 0;
+    uint64_t t0 = 0, t1 = 0;
+    double ns = 0;
+
+    ctx.rb = ringbuffer_alloc_mode(RINGBUF_ALLOC_SIZE(buf_size), mem, mode);
+    ctx.chunk = chunk;
+    ctx.ops = bench_bytes / chunk;
+    ctx.batch = batch;
+
+    t0 = bench_now_ns();
+    pthread_create(&producer, 0, bench_spsc_producer, &ctx);
+    for(i = 0; i < ctx.ops; ) {
+        if( batch ) ringbuffer_read_batch_begin(ctx.rb);
+        for(n = 0; n < (batch ? BENCH_BATCH : 1); n++) {
+            if( ringbuffer_read(ctx.rb, dst, chunk) != chunk ) break;
+            i++;
+        }
+        if( batch ) ringbuffer_read_batch_end(ctx.rb);
+        if( !n ) sched_yield();
+    }
+    pthread_join(producer, 0);
+    t1 = bench_now_ns();
+
+    ns = (double)(t1 - t0);
+    printf("%s,%s,%zu,%zu,1,%s,%zu,%.2f,%.1f,,,\n",
+           batch ? "spsc_threads_batch" : "spsc_threads",
+           bench_mode_name(mode), buf_size, chunk, bench_layout,
+           ctx.ops, ns / ctx.ops, (double)(ctx.ops * chunk) * 1000.0 / ns);
+
+    free(mem);
+}
+
+typedef struct bench_lat_t_ {
+    ringbuffer_t *rb;
+    size_t       samples;
+} bench_lat_t;
+
+static void *bench_lat_producer(void *arg) {
+    bench_lat_t *ctx = (bench_lat_t*)arg;
+    size_t i = 0;
+    for(i = 0; i < ctx->samples; ) {
+        uint64_t ts = bench_now_ns();
+        if( ringbuffer_write(ctx->rb, (uint8_t*)&ts, sizeof(ts)) == sizeof(ts) ) {
+            i++;
+        } else {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+static int bench_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* producer stamps each 8 byte message, consumer records now - stamp */
+static void bench_latency(uint8_t mode, size_t buf_size) {
+    uint8_t *mem = (uint8_t*)malloc(RINGBUF_ALLOC_SIZE(buf_size));
+    uint64_t *lat = (uint64_t*)malloc(BENCH_LAT_SAMPLES * sizeof(uint64_t));
+    bench_lat_t ctx;
+    pthread_t producer;
+    size_t n = 0;
+
+    ctx.rb = ringbuffer_alloc_mode(RINGBUF_ALLOC_SIZE(buf_size), mem, mode);
+    ctx.samples = BENCH_LAT_SAMPLES;
+
+    pthread_create(&producer, 0, bench_lat_producer, &ctx);
+    while( n < BENCH_LAT_SAMPLES ) {
+        uint64_t ts = 0;
+        if( ringbuffer_read(ctx.rb, (uint8_t*)&ts, sizeof(ts)) == sizeof(ts) ) {
+            lat[n++] = bench_now_ns() - ts;
+        } else {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, 0);
+
+    qsort(lat, n, sizeof(uint64_t), bench_cmp_u64);
+    printf("latency,%s,%zu,%zu,1,spsc_threads,%zu,,,%llu,%llu,%llu\n",
+           bench_mode_name(mode), buf_size, sizeof(uint64_t), n,
+           (unsigned long long)lat[n / 2],
+           (unsigned long long)lat[n * 99 / 100],
+           (unsigned long long)lat[n * 999 / 1000]);
+
+    free(lat);
+    free(mem);
+}
+
+int main(int argc, char **argv) {
+    static const size_t chunks[] = { 1, 4, 16, 64, 256, 1024, 4096, 16384, 65536 };
+    static const size_t bufs[] = { 4096, 65536, 1024*1024 };
+    static const uint8_t modes[] = { 0, RINGBUF_MODE_POW2, RINGBUF_MODE_SPSC };
+    size_t c = 0, b = 0, m = 0;
+    int ac = 0, wrap = 0;
+
+    if( argc > 1 ) {
+        bench_bytes = (size_t)atol(argv[1]) * 1024 * 1024;
+    }
+
+    bench_header();
+
+    for(m = 0; m < sizeof(modes); m++)
+    for(b = 0; b < sizeof(bufs)/sizeof(bufs[0]); b++)
+    for(c = 0; c < sizeof(chunks)/sizeof(chunks[0]); c++)
+    for(ac = 1; ac >= 0; ac--)
+    for(wrap = 0; wrap <= 1; wrap++) {
+        if( chunks[c] > bufs[b] ) continue;
+        bench_rw(modes[m], bufs[b], chunks[c], ac, wrap);
+    }
+
+    for(m = 0; m < sizeof(modes); m++) {
+        bench_bytes_rw(modes[m], 0);
+        bench_bytes_rw(modes[m], 1);
+    }
+
+    bench_fsm(0);
+    bench_fsm(1);
+
+    for(c = 2; c < 6; c++) {
+        bench_lines(chunks[c], 0);
+        bench_lines(chunks[c], 1);
+    }
+
+    for(c = 0; c < sizeof(chunks)/sizeof(chunks[0]) && chunks[c] <= 4096; c++) {
+        bench_static_rw(chunks[c]);
+    }
+
+    for(c = 0; c < 4; c++) {
+        bench_spsc_threads(RINGBUF_MODE_SPSC, 65536, chunks[c], 0);
+        bench_spsc_threads(RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2, 65536, chunks[c], 0);
+        bench_spsc_threads(RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2, 65536, chunks[c], 1);
+    }
+
+    bench_latency(RINGBUF_MODE_SPSC, 4096);
+    bench_latency(RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2, 4096);
+
+    return 0;
+}
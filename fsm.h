@@ -57,4 +57,151 @@ static name##__fsm__t name##__fsm__var = 0; \
     name##__fsm__var = fsmlocal; \
     } \
 
+/* Instance based variant: state and stack live in a caller owned
+   name##__ctx__t, so any number of machines of one kind can run at
+   once. Declare with FSM_DECLARE ... FSM_CTX_DECLARE_END(name, n),
+   the FSM_STATE_* / FSM_TRANS / FSM_S macros work as above. */
+
+#define FSM_CTX_DECLARE_END(name, n) \
+ , name##__ST_FINAL \
+} name##__fsm__t ; \
+typedef struct name##__ctx__t_ { \
+    name##__fsm__t state; \
+    unsigned       sp; \
+    name##__fsm__t stack[n]; \
+} name##__ctx__t; \
+
+#define FSM_CTX_INIT(ctx) ((ctx)->state = 0, (ctx)->sp = 0)
+
+#define FSM_CTX_DONE(name, ctx) ((ctx)->state == name##__ST_FINAL)
+
+#define FSM_CTX_STACK_PUSH(n) fsmctx->stack[fsmctx->sp++] = (n)
+#define FSM_CTX_STACK_POP()   fsmctx->stack[--fsmctx->sp]
+
+/* One step, like FSM_BEGIN/FSM_END. A machine in the final state stays
+   there */
+#define FSM_CTX_BEGIN(name, ctx) { \
+    name##__ctx__t *fsmctx = (ctx); \
+    name##__fsm__t fsmlocal = fsmctx->state; \
+    const  name##__fsm__t fsmfinal = name##__ST_FINAL; \
+    (void)fsmfinal; \
+    switch(fsmlocal) { \
+    case name##__ST_FINAL: break; \
+
+#define FSM_CTX_END(name) \
+    } \
+    fsmctx->state = fsmlocal; \
+    } \
+
+/* Runs steps until the final state or until FSM_CTX_GETC finds the
+   ring empty. Then the state is kept and re-entered from its start by
+   the next FSM_CTX_RUN, so a state takes at most one byte per entry.
+   FSM_CTX_GETC leaves with `break`, do not put it inside a loop */
+#define FSM_CTX_RUN(name, ctx) { \
+    name##__ctx__t *fsmctx = (ctx); \
+    name##__fsm__t fsmlocal = fsmctx->state; \
+    const  name##__fsm__t fsmfinal = name##__ST_FINAL; \
+    int fsmdry = 0; \
+    while( !fsmdry && fsmlocal != fsmfinal ) { \
+    switch(fsmlocal) { \
+    case name##__ST_FINAL: break; \
+
+#define FSM_CTX_GETC(rb, c) \
+    if( ((c) = ringbuffer_getc(rb)) < 0 ) { fsmdry = 1; break; }
+
+#define FSM_CTX_RUN_END(name) \
+    } \
+    } \
+    fsmctx->state = fsmlocal; \
+    } \
+
+/* Span variant: one call runs the machine over a whole byte buffer.
+   The states are listed once as an X-macro,
+
+    #define HTTP_STATES(X) X(LINE) X(NAME) X(VALUE)
+    FSM_SPAN_DECLARE(http, HTTP_STATES, 4)
+
+   which gives the same http__ctx__t as FSM_CTX_DECLARE_END (use
+   FSM_CTX_INIT/FSM_CTX_DONE/FSM_CTX_STACK_*). The body is
+
+    FSM_SPAN_BEGIN(http, HTTP_STATES, &ctx, ptr, len)
+        FSM_SPAN_STATE(LINE)
+            if( FSM_SPAN_BYTE == '\r' ) FSM_SPAN_GOTO(LINE);
+            ...
+    FSM_SPAN_END(http, used)
+
+   Entering a state takes the next byte, or saves the state and leaves
+   when the buffer is used up; the next call continues there. Moving to
+   another state is a plain goto, the only indirect dispatch is on entry
+   and FSM_SPAN_RETURN (pop a state pushed with FSM_CTX_STACK_PUSH).
+   With GCC/clang that is a computed goto, elsewhere or with
+   FSM_NO_COMPUTED_GOTO a switch. One FSM_SPAN per function. */
+
+#define FSM_X_ENUM(s)  s##__ST,
+#define FSM_X_LABEL(s) &&fsm__l_##s,
+#define FSM_X_CASE(s)  case s##__ST: goto fsm__l_##s;
+
+#define FSM_SPAN_DECLARE(name, STATES, n) \
+typedef enum { \
+    STATES(FSM_X_ENUM) \
+    name##__ST_FINAL \
+} name##__fsm__t ; \
+typedef struct name##__ctx__t_ { \
+    name##__fsm__t state; \
+    unsigned       sp; \
+    name##__fsm__t stack[n]; \
+} name##__ctx__t; \
+
+#if defined(__GNUC__) && !defined(FSM_NO_COMPUTED_GOTO)
+#define FSM_SPAN_DISPATCH(STATES) { \
+    static const void *const fsmtab[] = { STATES(FSM_X_LABEL) &&fsm__final }; \
+    goto *fsmtab[fsmnext]; \
+    }
+#else
+#define FSM_SPAN_DISPATCH(STATES) \
+    switch(fsmnext) { \
+        STATES(FSM_X_CASE) \
+        default: goto fsm__final; \
+    }
+#endif
+
+#define FSM_SPAN_BEGIN(name, STATES, ctx, ptr, len) { \
+    name##__ctx__t *fsmctx = (ctx); \
+    const uint8_t *const fsmp0 = (const uint8_t*)(ptr); \
+    const uint8_t *fsmp = fsmp0; \
+    const uint8_t *const fsmpe = fsmp0 + (len); \
+    name##__fsm__t fsmnext = fsmctx->state; \
+    uint8_t fsmc = 0; \
+    (void)fsmc; \
+    fsm__dispatch: \
+    FSM_SPAN_DISPATCH(STATES) \
+
+#define FSM_SPAN_STATE(s) \
+    fsm__l_##s: \
+    if( fsmp == fsmpe ) { \
+        fsmctx->state = s##__ST; \
+        goto fsm__out; \
+    } \
+    fsmc = *fsmp++; \
+
+#define FSM_SPAN_BYTE (fsmc)
+
+#define FSM_SPAN_GOTO(s) goto fsm__l_##s
+
+#define FSM_SPAN_FINAL() goto fsm__final
+
+#define FSM_SPAN_RETURN() do { \
+    fsmnext = FSM_CTX_STACK_POP(); \
+    goto fsm__dispatch; \
+    } while(0)
+
+/* `used`: bytes taken, less than len only if the final state was reached */
+#define FSM_SPAN_END(name, used) \
+    fsm__final: \
+    fsmctx->state = name##__ST_FINAL; \
+    fsm__out: \
+    (used) = (size_t)(fsmp - fsmp0); \
+    if( 0 ) goto fsm__dispatch; \
+    } \
+
 #endif
@@ -0,0 +1,86 @@
+/* Compile only: the fsm.h macros as a user writes them must build
+   warning free, make runs this with -Wall -Wextra -Werror for both the
+   computed goto and the FSM_NO_COMPUTED_GOTO dispatch. */
+
+#include <stddef.h>
+
+#include "fsm.h"
+#include "ringbuf.h"
+
+FSM_DECLARE(chk_step, STEP_A)
+    FSM_STATE_DECL(STEP_B)
+FSM_CTX_DECLARE_END(chk_step, 1)
+
+/* one step per call, the body never names the final state */
+void fsm_check_step(chk_step__ctx__t *ctx, int *n) {
+    FSM_CTX_BEGIN(chk_step, ctx)
+        FSM_STATE_BEGIN(STEP_A)
+            (*n)++;
+        FSM_STATE_ENDS(STEP_B)
+        FSM_STATE_BEGIN(STEP_B)
+            (*n)--;
+        FSM_STATE_ENDS(STEP_A)
+    FSM_CTX_END(chk_step)
+}
+
+FSM_DECLARE(chk_run, RUN_TEXT)
+    FSM_STATE_DECL(RUN_ESC)
+FSM_CTX_DECLARE_END(chk_run, 1)
+
+void fsm_check_run(chk_run__ctx__t *ctx, ringbuffer_t *rb, int *n) {
+    int c = 0;
+    FSM_CTX_RUN(chk_run, ctx)
+        FSM_STATE_BEGIN(RUN_TEXT)
+            FSM_CTX_GETC(rb, c)
+            if( c == '\\' ) {
+                FSM_CTX_STACK_PUSH(FSM_CURRENT_STATE);
+                FSM_TRANS(FSM_S(RUN_ESC));
+            } else if( c == '.' ) {
+                FSM_TRANS(FSM_FINAL_STATE);
+            } else {
+                (*n)++;
+            }
+        FSM_STATE_END(FSM_CURRENT_STATE)
+        FSM_STATE_BEGIN(RUN_ESC)
+            FSM_CTX_GETC(rb, c)
+            FSM_TRANS(FSM_CTX_STACK_POP());
+        FSM_STATE_END(FSM_CURRENT_STATE)
+    FSM_CTX_RUN_END(chk_run)
+}
+
+#define CHK_SPAN_STATES(X) X(SPAN_WORD) X(SPAN_SPACE)
+FSM_SPAN_DECLARE(chk_span, CHK_SPAN_STATES, 1)
+
+/* no FSM_SPAN_RETURN and no FSM_SPAN_FINAL: the macros must not leave
+   unused labels behind */
+size_t fsm_check_span(chk_span__ctx__t *ctx, const uint8_t *p, size_t len, int *words) {
+    size_t used = 0;
+    FSM_SPAN_BEGIN(chk_span, CHK_SPAN_STATES, ctx, p, len)
+        FSM_SPAN_STATE(SPAN_WORD)
+            if( FSM_SPAN_BYTE == ' ' ) FSM_SPAN_GOTO(SPAN_SPACE);
+            FSM_SPAN_GOTO(SPAN_WORD);
+        FSM_SPAN_STATE(SPAN_SPACE)
+            if( FSM_SPAN_BYTE == ' ' ) FSM_SPAN_GOTO(SPAN_SPACE);
+            (*words)++;
+            FSM_SPAN_GOTO(SPAN_WORD);
+    FSM_SPAN_END(chk_span, used)
+    return used;
+}
+
+#define CHK_SKIP_STATES(X) X(SKIP_OPEN) X(SKIP_NESTED)
+FSM_SPAN_DECLARE(chk_skip, CHK_SKIP_STATES, 2)
+
+/* counts bytes without looking at them, then stops: FSM_SPAN_BYTE is
+   never read */
+size_t fsm_check_skip(chk_skip__ctx__t *ctx, const uint8_t *p, size_t len, size_t n) {
+    size_t used = 0;
+    FSM_SPAN_BEGIN(chk_skip, CHK_SKIP_STATES, ctx, p, len)
+        FSM_SPAN_STATE(SKIP_OPEN)
+            FSM_CTX_STACK_PUSH(FSM_S(SKIP_OPEN));
+            FSM_SPAN_GOTO(SKIP_NESTED);
+        FSM_SPAN_STATE(SKIP_NESTED)
+            if( --n == 0 ) FSM_SPAN_FINAL();
+            FSM_SPAN_RETURN();
+    FSM_SPAN_END(chk_skip, used)
+    return used;
+}
@@ -6,9 +6,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifndef RINGBUF_NO_ATOMICS
+#include <stdatomic.h>
+#define rb_load_relaxed(p)      atomic_load_explicit((p), memory_order_relaxed)
+#define rb_load_acquire(p)      atomic_load_explicit((p), memory_order_acquire)
+#define rb_store_relaxed(p, v)  atomic_store_explicit((p), (v), memory_order_relaxed)
+#define rb_store_release(p, v)  atomic_store_explicit((p), (v), memory_order_release)
+#else
+#define rb_load_relaxed(p)      (*(p))
+#define rb_load_acquire(p)      (*(p))
+#define rb_store_relaxed(p, v)  (*(p) = (v))
+#define rb_store_release(p, v)  (*(p) = (v))
+#endif
+
+/* RINGBUF_STATS: every counter has a single writer, so a relaxed
+   load/store pair is enough and readers on other threads see whole values */
+#ifdef RINGBUF_STATS
+#define rb_stat_add(rb, f, v)  rb_store_relaxed(&(rb)->st_##f, rb_load_relaxed(&(rb)->st_##f) + (v))
+#define rb_stat_max(rb, f, v)  do { \
+        size_t v_ = (v); \
+        if( v_ > rb_load_relaxed(&(rb)->st_##f) ) rb_store_relaxed(&(rb)->st_##f, v_); \
+    } while(0)
+#else
+#define rb_stat_add(rb, f, v)  ((void)0)
+#define rb_stat_max(rb, f, v)  ((void)0)
+#endif
+
 /*#define ringbuffer_shift_ptr(p, s, e, w) ((p) + (w) < (e) ? (p) + (w) : (s) + ((w) - ((size_t)((e)-(p)))))*/
 #define safe_sub(a, b) ((a) >= (b) ? ((a) - (b)) : 0)
 
+/* MPSC headers are atomic 32 bit words in data */
+_Static_assert(offsetof(ringbuffer_t, data) % sizeof(size_t) == 0, "ringbuffer_t: data must be word aligned");
+
+/* modes where wcount/rcount, not the pointers and `written`, hold the state */
+#define RINGBUF_MODE_COUNTERS (RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2)
+
 typedef enum {
   RINGBUF_STATE_1 = 0      //  #   RA   [WP] WA  [RP]  RA   #
 , RINGBUF_STATE_2          //  #   WA   [RP] RA  [WP]  WA   #
@@ -43,54 +75,220 @@ static inline uint8_t *ringbuffer_shift_ptr(uint8_t *p, uint8_t *s, uint8_t *e,
 
 void ringbuffer_reset(ringbuffer_t *rb) {
     rb->flags = RINGBUF_DEFAULT_FLAGS;
-    rb->bs = &rb->data[0];
-    rb->be = &rb->data[rb->data_size];
     rb->rp = rb->bs;
     rb->wp = rb->bs;
     rb->written = 0;
     rb->twritten = 0;
     rb->twp = rb->wp;
+    rb->tgen = 0;
+    rb->overrun = 0;
+    rb_store_relaxed(&rb->wcount, 0);
+    rb_store_relaxed(&rb->rcount, 0);
+    rb->rcount_cache = 0;
+    rb->wcount_cache = 0;
+    rb->tread = 0;
+    rb->rbatch = 0;
+    rb->wbatch = 0;
+#ifdef RINGBUF_STATS
+    rb_store_relaxed(&rb->st_written, 0);
+    rb_store_relaxed(&rb->st_read, 0);
+    rb_store_relaxed(&rb->st_short_writes, 0);
+    rb_store_relaxed(&rb->st_commits, 0);
+    rb_store_relaxed(&rb->st_rollbacks, 0);
+    rb_store_relaxed(&rb->st_hwm, 0);
+    rb_store_relaxed(&rb->st_wraps, 0);
+#endif
+    if( rb->mode & RINGBUF_MODE_MPSC ) {
+        /* a zero word is an unpublished record header */
+        memset(rb->bs, 0, rb->data_size);
+    }
 }
 
 
+size_t ringbuffer_pow2_floor(size_t n) {
+    size_t p = 1;
+    while( n >> 1 >= p ) p <<= 1;
+    return n ? p : 0;
+}
+
 ringbuffer_t* ringbuffer_alloc(size_t data_size, uint8_t *data) {
-    if( data_size < sizeof(ringbuffer_t) ) {
+    return ringbuffer_alloc_mode(data_size, data, 0);
+}
+
+ringbuffer_t* ringbuffer_alloc_mode(size_t data_size, uint8_t *data, uint8_t mode) {
+#ifdef RINGBUF_NO_ATOMICS
+    if( mode & (RINGBUF_MODE_SPSC | RINGBUF_MODE_MPSC | RINGBUF_MODE_SHM) ) {
+        return (ringbuffer_t*)0;
+    }
+#endif
+    if( mode & RINGBUF_MODE_MPSC ) {
+        mode |= RINGBUF_MODE_POW2;
+    }
+    if( mode & RINGBUF_MODE_SHM ) {
+        if( mode & (RINGBUF_MODE_MPSC | RINGBUF_MODE_MIRROR) ) return (ringbuffer_t*)0;
+        mode |= RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2;
+    }
+    if( data_size < RINGBUF_ALLOC_SIZE(1) ) {
         return (ringbuffer_t*)0;
     } else {
-        ringbuffer_t *tmp = (ringbuffer_t*)data;
-        tmp->data_size = data_size - sizeof(ringbuffer_t) + 1;
+        ringbuffer_t *tmp = (ringbuffer_t*)0;
+#ifdef RINGBUF_CACHELINE
+        /* the slack only absorbs the alignment, the capacity must not
+           depend on where the caller's array happens to sit */
+        data = (uint8_t*)(((uintptr_t)data + RINGBUF_CACHELINE - 1) & ~(uintptr_t)(RINGBUF_CACHELINE - 1));
+#endif
+        /* MPSC record headers are atomic 32 bit words */
+        if( (mode & RINGBUF_MODE_MPSC) && (((uintptr_t)data + offsetof(ringbuffer_t, data)) & 3) ) {
+            return (ringbuffer_t*)0;
+        }
+        tmp = (ringbuffer_t*)data;
+        tmp->data_size = data_size - RINGBUF_ALLOC_SIZE(0);
+        if( mode & RINGBUF_MODE_POW2 ) {
+            tmp->data_size = ringbuffer_pow2_floor(tmp->data_size);
+        }
+        tmp->mode = mode;
+        tmp->grow_max = 0;
+        tmp->bs = &tmp->data[0];
+        tmp->be = &tmp->data[tmp->data_size];
         ringbuffer_reset(tmp);
         return tmp;
     }
     return (ringbuffer_t*)0;
 }
 
-size_t ringbuffer_write_avail(ringbuffer_t *rb) {
-    uint8_t *rp = rb->rp;
-    uint8_t *wp = rb->twp;
-    uint8_t *bs = rb->bs;
-    uint8_t *be = rb->be;
-    size_t  avail = 0;
+/* SPSC and POW2 modes: wcount/rcount are free running byte counters.
+   The producer owns twp/wp/twritten/wcount, the consumer owns rp/rcount.
+   Each side only loads the other side's counter (acquire) and publishes
+   its own one (release), `written` is not used.
 
-    switch( ringbuffer_get_state(rb) ) {
-        case RINGBUF_STATE_1:
-            avail = (size_t)(rp - wp);
-            break;
-        case RINGBUF_STATE_2:
-            avail = ((size_t)(be - wp) + (size_t)(rp - bs));
-            break;
-        case RINGBUF_STATE_3:
-            avail = ((size_t)(be - wp) + (size_t)(wp - bs));
-            break;
-        case RINGBUF_STATE_4:
-            avail = 0;
-            break;
+   POW2 mode derives positions from the counters (count & mask), so rp,
+   wp and twp are not maintained there. */
+
+/* Each side keeps a cached copy of the other side's counter and only
+   reloads it (touching the remote cache line) when the cached view does
+   not have `want` bytes. */
+
+static inline size_t ringbuffer_counters_write_avail(ringbuffer_t *rb, size_t want) {
+    size_t wcount = rb_load_relaxed(&rb->wcount);
+    size_t avail = rb->data_size - (wcount - rb->rcount_cache) - rb->twritten;
+    if( avail < want ) {
+        rb->rcount_cache = rb_load_acquire(&rb->rcount);
+        avail = rb->data_size - (wcount - rb->rcount_cache) - rb->twritten;
     }
+    return avail;
+}
 
+static inline size_t ringbuffer_counters_read_avail(ringbuffer_t *rb, size_t want) {
+    size_t rcount = rb_load_relaxed(&rb->rcount) + rb->tread;
+    size_t avail = rb->wcount_cache - rcount;
+    if( avail < want ) {
+        rb->wcount_cache = rb_load_acquire(&rb->wcount);
+        avail = rb->wcount_cache - rcount;
+    }
     return avail;
 }
 
+/* SHM mode: the header is mapped at a different address in every
+   process, bs/be are only valid in the one that called alloc */
+static inline uint8_t *ringbuffer_base(ringbuffer_t *rb) {
+    return (rb->mode & RINGBUF_MODE_SHM) ? rb->data : rb->bs;
+}
+
+static inline uint8_t *ringbuffer_wpos(ringbuffer_t *rb) {
+    if( rb->mode & RINGBUF_MODE_POW2 ) {
+        size_t twcount = rb_load_relaxed(&rb->wcount) + rb->twritten;
+        return ringbuffer_base(rb) + (twcount & (rb->data_size - 1));
+    }
+    return rb->twp;
+}
+
+static inline uint8_t *ringbuffer_rpos(ringbuffer_t *rb) {
+    if( rb->mode & RINGBUF_MODE_POW2 ) {
+        size_t trcount = rb_load_relaxed(&rb->rcount) + rb->tread;
+        return ringbuffer_base(rb) + (trcount & (rb->data_size - 1));
+    }
+    return rb->rp;
+}
+
+static inline size_t ringbuffer_spans(ringbuffer_t *rb, uint8_t *p, size_t len, ringbuffer_span_t *span) {
+    uint8_t *bs = ringbuffer_base(rb);
+    size_t rest = (rb->mode & RINGBUF_MODE_MIRROR) ? len : (size_t)(bs + rb->data_size - p);
+    span[0].ptr = p;
+    span[0].len = len <= rest ? len : rest;
+    span[1].ptr = bs;
+    span[1].len = len - span[0].len;
+    return len;
+}
+
+/* spans of len bytes at free running counter pos (POW2 modes) */
+size_t ringbuffer_spans_at(ringbuffer_t *rb, size_t pos, size_t len, ringbuffer_span_t span[2]) {
+    return ringbuffer_spans(rb, ringbuffer_base(rb) + (pos & (rb->data_size - 1)), len, span);
+}
+
+/* Most writes are a few bytes: below 16 use fixed size (overlapping)
+   moves the compiler inlines instead of a call into libc. Large copies
+   go to memcpy, which already picks the widest vector code */
+static inline void ringbuffer_memcpy(uint8_t *dst, const uint8_t *src, size_t n) {
+    if( n > 16 ) {
+        memcpy(dst, src, n);
+    } else if( n >= 8 ) {
+        memcpy(dst, src, 8);
+        memcpy(dst + n - 8, src + n - 8, 8);
+    } else if( n >= 4 ) {
+        memcpy(dst, src, 4);
+        memcpy(dst + n - 4, src + n - 4, 4);
+    } else if( n ) {
+        dst[0] = src[0];
+        dst[n / 2] = src[n / 2];
+        dst[n - 1] = src[n - 1];
+    }
+}
+
+/* copies min(total dst, total src) bytes from one span list to another */
+static size_t ringbuffer_copy_spans(const ringbuffer_span_t *dst, size_t dcnt, const ringbuffer_span_t *src, size_t scnt) {
+    size_t di = 0, doff = 0, si = 0, soff = 0, copied = 0;
+    while( di < dcnt && si < scnt ) {
+        size_t drest = dst[di].len - doff;
+        size_t srest = src[si].len - soff;
+        size_t n = drest < srest ? drest : srest;
+        if( n ) memcpy(dst[di].ptr + doff, src[si].ptr + soff, n);
+        copied += n;
+        doff += n;
+        soff += n;
+        if( doff == dst[di].len ) { di++; doff = 0; }
+        if( soff == src[si].len ) { si++; soff = 0; }
+    }
+    return copied;
+}
+
+static inline size_t ringbuffer_write_avail_for(ringbuffer_t *rb, size_t want) {
+    if( rb->mode & RINGBUF_MODE_COUNTERS ) {
+        return ringbuffer_counters_write_avail(rb, want);
+    }
+    return ringbuffer_write_avail(rb);
+}
+
+static inline size_t ringbuffer_read_avail_for(ringbuffer_t *rb, size_t want) {
+    if( rb->mode & RINGBUF_MODE_COUNTERS ) {
+        return ringbuffer_counters_read_avail(rb, want);
+    }
+    return ringbuffer_read_avail(rb);
+}
+
+size_t ringbuffer_write_avail(ringbuffer_t *rb) {
+    if( rb->mode & RINGBUF_MODE_COUNTERS ) {
+        return ringbuffer_counters_write_avail(rb, SIZE_MAX);
+    }
+
+    /* uncommitted bytes between wp and twp are not free either */
+    return safe_sub(rb->data_size, ringbuffer_read_avail(rb) + rb->twritten);
+}
+
 size_t ringbuffer_read_avail(ringbuffer_t *rb) {
+    if( rb->mode & RINGBUF_MODE_COUNTERS ) {
+        return ringbuffer_counters_read_avail(rb, SIZE_MAX);
+    }
+
     uint8_t *rp = rb->rp;
     uint8_t *wp = rb->wp;
     uint8_t *bs = rb->bs;
@@ -115,43 +313,223 @@ size_t ringbuffer_read_avail(ringbuffer_t *rb) {
     return avail;
 }
 
-size_t ringbuffer_write(ringbuffer_t *rb, const uint8_t *src, size_t size) {
-    uint8_t *rp = rb->rp;
-    uint8_t *wp = rb->twp;
-    uint8_t *bs = rb->bs;
-    uint8_t *be = rb->be;
-    size_t towrite = size;
+#ifndef RINGBUF_NO_HEAP
+
+/* HEAP mode: the header is fixed, bs..be is a separate allocation that
+   ringbuffer_resize() replaces. Concurrent and mapped modes are out */
+
+#define RINGBUF_MODE_NO_HEAP (RINGBUF_MODE_SPSC | RINGBUF_MODE_MPSC | RINGBUF_MODE_MIRROR | RINGBUF_MODE_SHM)
+
+static size_t ringbuffer_pow2_ceil(size_t n) {
+    size_t p = ringbuffer_pow2_floor(n);
+    return p == n ? n : p << 1;
+}
+
+ringbuffer_t* ringbuffer_new(size_t data_size, uint8_t mode) {
+    ringbuffer_t *rb = (ringbuffer_t*)0;
+    if( mode & RINGBUF_MODE_NO_HEAP ) return (ringbuffer_t*)0;
+    if( mode & RINGBUF_MODE_POW2 ) data_size = ringbuffer_pow2_ceil(data_size);
+    if( !data_size ) return (ringbuffer_t*)0;
+    rb = (ringbuffer_t*)aligned_alloc(_Alignof(ringbuffer_t), sizeof(ringbuffer_t));
+    if( !rb ) return (ringbuffer_t*)0;
+    rb->bs = (uint8_t*)malloc(data_size);
+    if( !rb->bs ) {
+        free(rb);
+        return (ringbuffer_t*)0;
+    }
+    rb->data_size = data_size;
+    rb->be = rb->bs + data_size;
+    rb->mode = mode | RINGBUF_MODE_HEAP;
+    rb->grow_max = 0;
+    ringbuffer_reset(rb);
+    return rb;
+}
+
+void ringbuffer_free(ringbuffer_t *rb) {
+    if( !rb ) return;
+    free(rb->bs);
+    free(rb);
+}
+
+/* Moves the unread bytes, then the open transaction, to the start of a
+   new data block. Spans and savepoint pointers taken before are stale.
+   Fails (-1, buffer unchanged) if they do not fit or malloc fails. */
+int ringbuffer_resize(ringbuffer_t *rb, size_t data_size) {
+    ringbuffer_span_t span[2];
+    size_t used = 0, pending = rb->twritten;
+    uint8_t *data = (uint8_t*)0;
+
+    if( !(rb->mode & RINGBUF_MODE_HEAP) ) return -1;
+    if( rb->mode & RINGBUF_MODE_POW2 ) data_size = ringbuffer_pow2_ceil(data_size);
+
+    used = ringbuffer_read_avail(rb);
+    if( !data_size || used + pending > data_size ) return -1;
+
+    data = (uint8_t*)malloc(data_size);
+    if( !data ) return -1;
+
+    ringbuffer_spans(rb, ringbuffer_rpos(rb), used + pending, span);
+    memcpy(data, span[0].ptr, span[0].len);
+    memcpy(data + span[0].len, span[1].ptr, span[1].len);
+    free(rb->bs);
+
+    rb->bs = data;
+    rb->be = data + data_size;
+    rb->data_size = data_size;
+    rb->rp = data;
+    rb->wp = ringbuffer_shift_ptr(data, data, rb->be, used);
+    rb->twp = ringbuffer_shift_ptr(rb->wp, data, rb->be, pending);
+    rb_store_relaxed(&rb->rcount, 0);
+    rb_store_relaxed(&rb->wcount, used);
+    rb->rcount_cache = 0;
+    rb->wcount_cache = used;
+    rb->tread = 0;
+    return 0;
+}
+
+/* writes that do not fit grow the buffer geometrically, up to max_size.
+   0 turns it off */
+int ringbuffer_autogrow(ringbuffer_t *rb, size_t max_size) {
+    if( !(rb->mode & RINGBUF_MODE_HEAP) ) return -1;
+    rb->grow_max = max_size;
+    return 0;
+}
+
+/* want == SIZE_MAX is "whatever is free" (fill_from_fd, peeks), not a
+   size to grow to. More than fits under grow_max grows to the ceiling */
+static size_t ringbuffer_grow(ringbuffer_t *rb, size_t want) {
     size_t avail = ringbuffer_write_avail(rb);
-    towrite = towrite < avail ? towrite : avail;
-    if( !avail || !towrite ) return 0;
-    switch( ringbuffer_get_state(rb) ) {
-        case RINGBUF_STATE_1:
-            memcpy(wp, src, towrite);
-            break;
-        case RINGBUF_STATE_2:
-        case RINGBUF_STATE_3: {
-            size_t rest = (size_t)(be - wp);
-            size_t w1 = towrite <= rest ? towrite : rest;
-            size_t w2 = safe_sub(towrite, w1);
-            size_t rest2 = (size_t)(rp - bs);
-            size_t w3 = w2 <= rest2 ? w2 : rest2;
-            if( w1 ) memcpy(wp, src, w1);
-            if( w3 ) memcpy(bs, src + w1, w3);
-            }
-            break;
-        default:
-            towrite = 0;
-            break;
+    size_t used = rb->data_size - avail;
+    size_t need = 0, size = 0;
+    if( want == SIZE_MAX || used >= rb->grow_max ) return avail;
+    need = want > rb->grow_max - used ? rb->grow_max : used + want;
+    size = rb->data_size * 2 > need ? rb->data_size * 2 : need;
+    if( rb->mode & RINGBUF_MODE_POW2 ) size = ringbuffer_pow2_ceil(size);
+    if( !size || size > rb->grow_max ) {
+        size = (rb->mode & RINGBUF_MODE_POW2) ? ringbuffer_pow2_floor(rb->grow_max) : rb->grow_max;
+    }
+    if( size > rb->data_size ) ringbuffer_resize(rb, size);
+    return ringbuffer_write_avail(rb);
+}
+
+#endif
+
+/* write_avail_for, growing the buffer first if auto-grow is on */
+static inline size_t ringbuffer_write_avail_grow(ringbuffer_t *rb, size_t want) {
+    size_t avail = ringbuffer_write_avail_for(rb, want);
+#ifndef RINGBUF_NO_HEAP
+    if( avail < want && rb->grow_max ) {
+        avail = ringbuffer_grow(rb, want);
     }
+#endif
+    return avail;
+}
 
-    rb->twp = ringbuffer_shift_ptr(wp, bs, be, towrite);
-    rb->twritten += towrite;
+size_t ringbuffer_write_reserve(ringbuffer_t *rb, size_t size, ringbuffer_span_t span[2]) {
+    size_t avail = ringbuffer_write_avail_grow(rb, size);
+    size_t towrite = size < avail ? size : avail;
+    return ringbuffer_spans(rb, ringbuffer_wpos(rb), towrite, span);
+}
+
+void ringbuffer_write_advance(ringbuffer_t *rb, size_t size) {
+    rb_stat_add(rb, wraps, (size_t)(ringbuffer_wpos(rb) - ringbuffer_base(rb)) + size >= rb->data_size);
+    if( !(rb->mode & RINGBUF_MODE_POW2) ) {
+        rb->twp = ringbuffer_shift_ptr(rb->twp, rb->bs, rb->be, size);
+    }
+    rb->twritten += size;
 
     if( rb->flags & RINGBUF_AUTOCOMMIT ) {
         ringbuffer_commit(rb);
     }
+}
+
+/* RINGBUF_OVERWRITE: drop the oldest committed bytes until size fits.
+   Only the producer runs here, so not in the concurrent modes */
+int ringbuffer_overwrite_mode(ringbuffer_t *rb) {
+    return (rb->flags & RINGBUF_OVERWRITE) && !(rb->mode & (RINGBUF_MODE_SPSC | RINGBUF_MODE_MPSC));
+}
 
-    return towrite;
+static void ringbuffer_make_room(ringbuffer_t *rb, size_t size) {
+    size_t avail = ringbuffer_write_avail_grow(rb, size);
+    if( size > avail ) {
+        size_t used = ringbuffer_read_avail(rb);
+        size_t drop = size - avail < used ? size - avail : used;
+        ringbuffer_read_consume(rb, drop);
+        rb->overrun += drop;
+    }
+}
+
+size_t ringbuffer_write(ringbuffer_t *rb, const uint8_t *src, size_t size) {
+    ringbuffer_span_t span[2];
+    size_t skip = 0, towrite = 0;
+    if( ringbuffer_overwrite_mode(rb) ) {
+        size_t cap = 0;
+        ringbuffer_write_avail_grow(rb, size);  /* grow before dropping */
+        /* more than fits at all: only the newest part survives */
+        cap = rb->data_size - rb->twritten;
+        skip = size > cap ? size - cap : 0;
+        rb->overrun += skip;
+        ringbuffer_make_room(rb, size - skip);
+    }
+    towrite = ringbuffer_write_reserve(rb, size - skip, span);
+    if( towrite < size - skip ) rb_stat_add(rb, short_writes, 1);
+    if( !towrite ) return skip;
+    ringbuffer_memcpy(span[0].ptr, src + skip, span[0].len);
+    if( span[1].len ) ringbuffer_memcpy(span[1].ptr, src + skip + span[0].len, span[1].len);
+    ringbuffer_write_advance(rb, towrite);
+    return skip + towrite;
+}
+
+/* single byte, no spans and no copy: returns 1 or 0 when full */
+int ringbuffer_putc(ringbuffer_t *rb, uint8_t c) {
+    if( ringbuffer_overwrite_mode(rb) ) {
+        ringbuffer_make_room(rb, 1);
+    }
+    if( !ringbuffer_write_avail_grow(rb, 1) ) {
+        rb_stat_add(rb, short_writes, 1);
+        return 0;
+    }
+    *ringbuffer_wpos(rb) = c;
+    ringbuffer_write_advance(rb, 1);
+    return 1;
+}
+
+size_t ringbuffer_writev(ringbuffer_t *rb, const ringbuffer_span_t *iov, size_t iovcnt) {
+    ringbuffer_span_t span[2];
+    size_t total = 0, i = 0;
+    for(i = 0; i < iovcnt; i++) total += iov[i].len;
+    if( ringbuffer_overwrite_mode(rb) && ringbuffer_write_avail_grow(rb, total) < total
+        && total <= rb->data_size - rb->twritten ) {
+        ringbuffer_make_room(rb, total);
+    }
+    /* all or nothing: a message is never split by a short write */
+    if( !total ) return 0;
+    if( ringbuffer_write_reserve(rb, total, span) < total ) {
+        rb_stat_add(rb, short_writes, 1);
+        return 0;
+    }
+    ringbuffer_copy_spans(span, 2, iov, iovcnt);
+    ringbuffer_write_advance(rb, total);
+    return total;
+}
+
+size_t ringbuffer_overrun(ringbuffer_t *rb) {
+    return rb->overrun;
+}
+
+void ringbuffer_stats(ringbuffer_t *rb, ringbuffer_stats_t *st) {
+    memset(st, 0, sizeof(*st));
+#ifdef RINGBUF_STATS
+    st->written = rb_load_relaxed(&rb->st_written);
+    st->read = rb_load_relaxed(&rb->st_read);
+    st->short_writes = rb_load_relaxed(&rb->st_short_writes);
+    st->commits = rb_load_relaxed(&rb->st_commits);
+    st->rollbacks = rb_load_relaxed(&rb->st_rollbacks);
+    st->hwm = rb_load_relaxed(&rb->st_hwm);
+    st->wraps = rb_load_relaxed(&rb->st_wraps);
+#else
+    (void)rb;
+#endif
 }
 
 void ringbuffer_update_flags(ringbuffer_t *rb, uint8_t set, uint8_t flag) {
@@ -159,52 +537,145 @@ void ringbuffer_update_flags(ringbuffer_t *rb, uint8_t set, uint8_t flag) {
 }
 
 void ringbuffer_commit(ringbuffer_t *rb) {
+    rb_stat_add(rb, written, rb->twritten);
+    rb_stat_add(rb, commits, 1);
     rb->wp = rb->twp;
-    rb->written += rb->twritten;
+    if( rb->mode & RINGBUF_MODE_COUNTERS ) {
+        rb_store_release(&rb->wcount, rb_load_relaxed(&rb->wcount) + rb->twritten);
+    } else {
+        rb->written += rb->twritten;
+    }
+    rb_stat_max(rb, hwm, (rb->mode & RINGBUF_MODE_COUNTERS)
+                         ? rb_load_relaxed(&rb->wcount) - rb_load_relaxed(&rb->rcount)
+                         : rb->written);
     rb->twritten = 0;
+    rb->tgen++;
 }
 
 void ringbuffer_rollback(ringbuffer_t *rb) {
+    rb_stat_add(rb, rollbacks, 1);
     rb->twp = rb->wp;
     rb->twritten = 0;
+    rb->tgen++;
 }
 
-size_t ringbuffer_read(ringbuffer_t *rb, uint8_t *dst, size_t size) {
-    uint8_t *rp = rb->rp;
-    uint8_t *wp = rb->wp;
-    uint8_t *bs = rb->bs;
-    uint8_t *be = rb->be;
-    size_t toread = size;
-    size_t avail = ringbuffer_read_avail(rb);
-    int _state = RINGBUF_STATE_INVALID;
-    toread = toread < avail ? toread : avail;
-    _state = ringbuffer_get_state(rb);
-    if( !avail || !toread ) return 0;
-    switch( ringbuffer_get_state(rb) ) {
-        case RINGBUF_STATE_1:
-        case RINGBUF_STATE_4: {
-            size_t rest = (size_t)(be - rp);
-            size_t r1 = toread <= rest ? toread : rest;
-            size_t r2 = safe_sub(toread, r1);
-            size_t rest2 = (size_t)(wp - bs);
-            size_t r3 = r2 <= rest2 ? r2 : rest2;
-            if( r1 ) {
-                memcpy(dst, rp, r1);
-            }
-            if( r3 ) {
-                memcpy(dst + r1, bs, r3);
-            }
+void ringbuffer_savepoint(ringbuffer_t *rb, ringbuffer_savepoint_t *sp) {
+    sp->twp = rb->twp;
+    sp->twritten = rb->twritten;
+    sp->tgen = rb->tgen;
+}
+
+void ringbuffer_rollback_to(ringbuffer_t *rb, const ringbuffer_savepoint_t *sp) {
+    /* savepoints taken before the last commit/rollback are stale, and so
+       are ones past an earlier rollback_to in this transaction */
+    if( sp->tgen != rb->tgen || sp->twritten > rb->twritten ) return;
+    rb_stat_add(rb, rollbacks, 1);
+    /* from wp, not sp->twp: a resize may have moved the data */
+    rb->twp = ringbuffer_shift_ptr(rb->wp, rb->bs, rb->be, sp->twritten);
+    rb->twritten = sp->twritten;
+}
+
+size_t ringbuffer_read_peek(ringbuffer_t *rb, size_t size, ringbuffer_span_t span[2]) {
+    size_t avail = ringbuffer_read_avail_for(rb, size);
+    size_t toread = size < avail ? size : avail;
+    return ringbuffer_spans(rb, ringbuffer_rpos(rb), toread, span);
+}
+
+void ringbuffer_read_consume(ringbuffer_t *rb, size_t size) {
+    rb_stat_add(rb, read, size);
+    if( !(rb->mode & RINGBUF_MODE_POW2) ) {
+        rb->rp = ringbuffer_shift_ptr(rb->rp, rb->bs, rb->be, size);
+    }
+    if( rb->mode & RINGBUF_MODE_COUNTERS ) {
+        if( rb->rbatch ) {
+            rb->tread += size;
+        } else {
+            rb_store_release(&rb->rcount, rb_load_relaxed(&rb->rcount) + size);
         }
-        break;
-        case RINGBUF_STATE_2:
-            memcpy(dst, rp, toread);
-            break;
-        default:
-            toread = 0;
-            break;
+    } else {
+        rb->written = safe_sub(rb->written, size);
     }
-    rb->rp = ringbuffer_shift_ptr(rp, bs, be, toread);
-    rb->written = safe_sub(rb->written, toread);
+}
+
+/* offset of the first `c` from the read position, RINGBUF_NPOS if the
+   readable bytes do not contain it. memchr over both spans, no copy */
+size_t ringbuffer_find(ringbuffer_t *rb, uint8_t c) {
+    ringbuffer_span_t span[2];
+    uint8_t *p = (uint8_t*)0;
+    if( !ringbuffer_read_peek(rb, SIZE_MAX, span) ) return RINGBUF_NPOS;
+    p = (uint8_t*)memchr(span[0].ptr, c, span[0].len);
+    if( p ) return (size_t)(p - span[0].ptr);
+    p = span[1].len ? (uint8_t*)memchr(span[1].ptr, c, span[1].len) : (uint8_t*)0;
+    if( p ) return span[0].len + (size_t)(p - span[1].ptr);
+    return RINGBUF_NPOS;
+}
+
+/* peeks everything up to and including `delim`, returns the length or 0
+   if there is no complete line yet. Like ringbuffer_read_peek() the
+   caller finishes with ringbuffer_read_consume(rb, len) */
+size_t ringbuffer_read_until(ringbuffer_t *rb, uint8_t delim, ringbuffer_span_t span[2]) {
+    size_t pos = ringbuffer_find(rb, delim);
+    if( pos == RINGBUF_NPOS ) {
+        span[0].len = span[1].len = 0;
+        return 0;
+    }
+    return ringbuffer_read_peek(rb, pos + 1, span);
+}
+
+/* Batches: in the counter modes consumed bytes are collected in `tread`
+   and rcount is published once, at ringbuffer_read_batch_end(). The
+   producer side batch is a transaction committed at the end. In the
+   default mode there is nobody to publish to, reads stay immediate. */
+
+void ringbuffer_read_batch_begin(ringbuffer_t *rb) {
+    rb->rbatch = 1;
+}
+
+void ringbuffer_read_batch_end(ringbuffer_t *rb) {
+    if( rb->tread ) {
+        rb_store_release(&rb->rcount, rb_load_relaxed(&rb->rcount) + rb->tread);
+        rb->tread = 0;
+    }
+    rb->rbatch = 0;
+}
+
+void ringbuffer_write_batch_begin(ringbuffer_t *rb) {
+    rb->wbatch = rb->flags & RINGBUF_AUTOCOMMIT;
+    rb->flags &= ~RINGBUF_AUTOCOMMIT;
+}
+
+void ringbuffer_write_batch_end(ringbuffer_t *rb) {
+    ringbuffer_commit(rb);
+    rb->flags |= rb->wbatch;
+    rb->wbatch = 0;
+}
+
+size_t ringbuffer_read(ringbuffer_t *rb, uint8_t *dst, size_t size) {
+    ringbuffer_span_t span[2];
+    size_t toread = ringbuffer_read_peek(rb, size, span);
+    if( !toread ) return 0;
+    ringbuffer_memcpy(dst, span[0].ptr, span[0].len);
+    if( span[1].len ) ringbuffer_memcpy(dst + span[0].len, span[1].ptr, span[1].len);
+    ringbuffer_read_consume(rb, toread);
     return toread;
 }
 
+/* returns the next byte or -1 when empty */
+int ringbuffer_getc(ringbuffer_t *rb) {
+    uint8_t c = 0;
+    if( !ringbuffer_read_avail_for(rb, 1) ) return -1;
+    c = *ringbuffer_rpos(rb);
+    ringbuffer_read_consume(rb, 1);
+    return c;
+}
+
+size_t ringbuffer_readv(ringbuffer_t *rb, const ringbuffer_span_t *iov, size_t iovcnt) {
+    ringbuffer_span_t span[2];
+    size_t total = 0, toread = 0, i = 0;
+    for(i = 0; i < iovcnt; i++) total += iov[i].len;
+    toread = ringbuffer_read_peek(rb, total, span);
+    if( !toread ) return 0;
+    ringbuffer_copy_spans(iov, iovcnt, span, 2);
+    ringbuffer_read_consume(rb, toread);
+    return toread;
+}
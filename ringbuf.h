@@ -4,33 +4,131 @@
 #include "ringbuf_setup.h"
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RINGBUF_NPOS ((size_t)-1)  /* ringbuffer_find(): not found */
+
 #define RINGBUF_AUTOCOMMIT 1
+#define RINGBUF_OVERWRITE  2   /* full buffer: drop the oldest data instead of short writes */
+
+/* Buffer modes, fixed at ringbuffer_alloc_mode() time */
+#define RINGBUF_MODE_SPSC   1  /* lock-free single producer / single consumer */
+#define RINGBUF_MODE_MIRROR 2  /* data mapped twice, see ringbuf_mirror.h */
+#define RINGBUF_MODE_POW2   4  /* power of two capacity, masked free running counters */
+#define RINGBUF_MODE_MPSC   8  /* multi producer records, see ringbuf_mpsc.h (implies POW2) */
+#define RINGBUF_MODE_SHM    16 /* no raw pointers used, see ringbuf_shm.h (implies SPSC|POW2) */
+#define RINGBUF_MODE_HEAP   32 /* data malloc'd apart from the header, see ringbuffer_new() */
 
 typedef struct ring_buffer_t_ {
 	uint8_t flags;
+	uint8_t mode;
     uint8_t *bs;
     uint8_t *be;
-    uint8_t *rp;
-    uint8_t *wp;
+    size_t  data_size;
     size_t  written;
+    /* producer side */
+    RINGBUF_ALIGNED uint8_t *wp;
 	uint8_t *twp;
-	uint8_t twritten;
-    size_t  data_size;
-    uint8_t data[1];
+	size_t  twritten;
+    size_t  tgen;                 /* transaction number, bumped by commit/rollback */
+    RINGBUF_ATOMIC(size_t) wcount; /* SPSC/POW2: bytes committed, producer owned; MPSC: claim cursor */
+    size_t  rcount_cache;         /* producer's last view of rcount */
+    size_t  overrun;              /* RINGBUF_OVERWRITE: bytes dropped */
+    uint8_t wbatch;               /* autocommit flag saved by ringbuffer_write_batch_begin */
+    size_t  grow_max;             /* HEAP: auto-grow ceiling, 0 = off */
+#ifdef RINGBUF_STATS
+    RINGBUF_ATOMIC(size_t) st_written;
+    RINGBUF_ATOMIC(size_t) st_short_writes;
+    RINGBUF_ATOMIC(size_t) st_commits;
+    RINGBUF_ATOMIC(size_t) st_rollbacks;
+    RINGBUF_ATOMIC(size_t) st_hwm;
+    RINGBUF_ATOMIC(size_t) st_wraps;
+#endif
+    /* consumer side */
+    RINGBUF_ALIGNED uint8_t *rp;
+    uint8_t rbatch;               /* before the size_t fields: data stays word aligned */
+    RINGBUF_ATOMIC(size_t) rcount; /* SPSC/POW2: bytes consumed, consumer owned */
+    size_t  wcount_cache;         /* consumer's last view of wcount */
+    size_t  tread;                /* consumed in the current batch, not yet published */
+#ifdef RINGBUF_STATS
+    RINGBUF_ATOMIC(size_t) st_read;
+#endif
+    RINGBUF_ALIGNED uint8_t data[1];
 } ringbuffer_t;
 
+/* Snapshot of the RINGBUF_STATS counters, see ringbuffer_stats() */
+typedef struct ringbuffer_stats_t_ {
+    size_t written;       /* bytes committed */
+    size_t read;          /* bytes consumed */
+    size_t short_writes;  /* write/writev/putc calls that did not fit */
+    size_t commits;
+    size_t rollbacks;
+    size_t hwm;           /* highest read_avail seen at a commit */
+    size_t wraps;         /* times the write position passed `be` */
+} ringbuffer_stats_t;
+
+/* Position inside the current transaction, see ringbuffer_rollback_to() */
+typedef struct ringbuffer_savepoint_t_ {
+    uint8_t *twp;
+    size_t   twritten;
+    size_t   tgen;
+} ringbuffer_savepoint_t;
+
+/* Contiguous piece of the buffer data. A region that crosses `be` is
+   returned as two spans, the second one starting at `bs` */
+typedef struct ringbuffer_span_t_ {
+    uint8_t *ptr;
+    size_t   len;
+} ringbuffer_span_t;
+
 void ringbuffer_reset(ringbuffer_t *rb);
 ringbuffer_t* ringbuffer_alloc(size_t data_size, uint8_t *data); 
+ringbuffer_t* ringbuffer_alloc_mode(size_t data_size, uint8_t *data, uint8_t mode);
+size_t ringbuffer_pow2_floor(size_t n);
+#ifndef RINGBUF_NO_HEAP
+ringbuffer_t* ringbuffer_new(size_t data_size, uint8_t mode);
+void ringbuffer_free(ringbuffer_t *rb);
+int ringbuffer_resize(ringbuffer_t *rb, size_t data_size);
+int ringbuffer_autogrow(ringbuffer_t *rb, size_t max_size);
+#endif
 size_t ringbuffer_write_avail(ringbuffer_t *rb);
 size_t ringbuffer_read_avail(ringbuffer_t *rb);
 size_t ringbuffer_write(ringbuffer_t *rb, const uint8_t *src, size_t size);
 size_t ringbuffer_read(ringbuffer_t *rb, uint8_t *dst, size_t size);
+int ringbuffer_putc(ringbuffer_t *rb, uint8_t c);
+int ringbuffer_getc(ringbuffer_t *rb);
+size_t ringbuffer_writev(ringbuffer_t *rb, const ringbuffer_span_t *iov, size_t iovcnt);
+size_t ringbuffer_readv(ringbuffer_t *rb, const ringbuffer_span_t *iov, size_t iovcnt);
+size_t ringbuffer_write_reserve(ringbuffer_t *rb, size_t size, ringbuffer_span_t span[2]);
+void ringbuffer_write_advance(ringbuffer_t *rb, size_t size);
+size_t ringbuffer_read_peek(ringbuffer_t *rb, size_t size, ringbuffer_span_t span[2]);
+void ringbuffer_read_consume(ringbuffer_t *rb, size_t size);
+size_t ringbuffer_find(ringbuffer_t *rb, uint8_t c);
+size_t ringbuffer_read_until(ringbuffer_t *rb, uint8_t delim, ringbuffer_span_t span[2]);
 void ringbuffer_commit(ringbuffer_t *rb);
 void ringbuffer_rollback(ringbuffer_t *rb);
+void ringbuffer_savepoint(ringbuffer_t *rb, ringbuffer_savepoint_t *sp);
+void ringbuffer_rollback_to(ringbuffer_t *rb, const ringbuffer_savepoint_t *sp);
+void ringbuffer_read_batch_begin(ringbuffer_t *rb);
+void ringbuffer_read_batch_end(ringbuffer_t *rb);
+void ringbuffer_write_batch_begin(ringbuffer_t *rb);
+void ringbuffer_write_batch_end(ringbuffer_t *rb);
 void ringbuffer_update_flags(ringbuffer_t *rb, uint8_t set, uint8_t flags);
+size_t ringbuffer_overrun(ringbuffer_t *rb);
+void ringbuffer_stats(ringbuffer_t *rb, ringbuffer_stats_t *st);
 
+/* internal, for the ringbuf_*.c modules */
+int ringbuffer_overwrite_mode(ringbuffer_t *rb);
+size_t ringbuffer_spans_at(ringbuffer_t *rb, size_t pos, size_t len, ringbuffer_span_t span[2]);
 
-#define RINGBUF_ALLOC_SIZE(n) (sizeof(ringbuffer_t) - 1 + (n))
+
+#define RINGBUF_ALLOC_SIZE(n) (sizeof(ringbuffer_t) - 1 + (n) + RINGBUF_ALLOC_SLACK)
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
 
@@ -0,0 +1,114 @@
+#include "ringbuf_bcast.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+#define RINGBUF_BCAST_FREE    ((size_t)-1)
+#define RINGBUF_BCAST_EVICTED ((size_t)-2)
+
+int ringbuffer_bcast_init(ringbuffer_bcast_t *b, ringbuffer_t *rb, size_t lag_max) {
+    int i = 0;
+    if( (rb->mode & (RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2)) != (RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2)
+     || (rb->mode & RINGBUF_MODE_MPSC) ) {
+        return -1;
+    }
+    b->rb = rb;
+    b->lag_max = lag_max;
+    for(i = 0; i < RINGBUF_BCAST_READERS; i++) {
+        atomic_init(&b->cursor[i].pos, RINGBUF_BCAST_FREE);
+    }
+    return 0;
+}
+
+/* Slowest live cursor, seen from the producer. Readers that are more than
+   lag_max behind are evicted on the way */
+static size_t ringbuffer_bcast_slowest(ringbuffer_bcast_t *b) {
+    size_t w = atomic_load_explicit(&b->rb->wcount, memory_order_relaxed);
+    size_t m = w;
+    int i = 0;
+    for(i = 0; i < RINGBUF_BCAST_READERS; i++) {
+        size_t c = atomic_load(&b->cursor[i].pos);
+        if( c >= RINGBUF_BCAST_EVICTED ) continue;
+        if( b->lag_max && w - c > b->lag_max ) {
+            if( atomic_compare_exchange_strong(&b->cursor[i].pos, &c, RINGBUF_BCAST_EVICTED) ) continue;
+            if( c >= RINGBUF_BCAST_EVICTED ) continue;
+        }
+        if( w - c > w - m ) m = c;
+    }
+    return m;
+}
+
+size_t ringbuffer_bcast_write_avail(ringbuffer_bcast_t *b, size_t want) {
+    size_t avail = ringbuffer_write_avail(b->rb);
+    size_t m = 0, m2 = 0;
+    if( avail >= want ) return avail;
+
+    /* publish the gate, then look again: a reader that joined meanwhile
+       either shows up now or sees the new gate and starts behind it */
+    m = ringbuffer_bcast_slowest(b);
+    atomic_store(&b->rb->rcount, m);
+    m2 = ringbuffer_bcast_slowest(b);
+    if( m2 != m ) atomic_store(&b->rb->rcount, m2);
+
+    return ringbuffer_write_avail(b->rb);
+}
+
+size_t ringbuffer_bcast_write(ringbuffer_bcast_t *b, const uint8_t *src, size_t size) {
+    ringbuffer_bcast_write_avail(b, size);
+    return ringbuffer_write(b->rb, src, size);
+}
+
+int ringbuffer_bcast_join(ringbuffer_bcast_t *b) {
+    int i = 0;
+    for(i = 0; i < RINGBUF_BCAST_READERS; i++) {
+        size_t c = RINGBUF_BCAST_FREE;
+        size_t r = atomic_load(&b->rb->rcount);
+        if( !atomic_compare_exchange_strong(&b->cursor[i].pos, &c, r) ) continue;
+        /* the producer may have moved the gate before it saw us */
+        while( (c = atomic_load(&b->rb->rcount)) != r ) {
+            r = c;
+            atomic_store(&b->cursor[i].pos, r);
+        }
+        return i;
+    }
+    return -1;
+}
+
+void ringbuffer_bcast_leave(ringbuffer_bcast_t *b, int id) {
+    atomic_store_explicit(&b->cursor[id].pos, RINGBUF_BCAST_FREE, memory_order_release);
+}
+
+int ringbuffer_bcast_evicted(ringbuffer_bcast_t *b, int id) {
+    return atomic_load_explicit(&b->cursor[id].pos, memory_order_relaxed) == RINGBUF_BCAST_EVICTED;
+}
+
+size_t ringbuffer_bcast_read_avail(ringbuffer_bcast_t *b, int id) {
+    size_t c = atomic_load_explicit(&b->cursor[id].pos, memory_order_relaxed);
+    if( c >= RINGBUF_BCAST_EVICTED ) return 0;
+    return atomic_load_explicit(&b->rb->wcount, memory_order_acquire) - c;
+}
+
+size_t ringbuffer_bcast_peek(ringbuffer_bcast_t *b, int id, size_t size, ringbuffer_span_t span[2]) {
+    size_t c = atomic_load_explicit(&b->cursor[id].pos, memory_order_relaxed);
+    size_t avail = ringbuffer_bcast_read_avail(b, id);
+    size_t toread = size < avail ? size : avail;
+    ringbuffer_spans_at(b->rb, c, toread, span);
+    return toread;
+}
+
+/* the cursor only moves by CAS, so an eviction in between is noticed */
+int ringbuffer_bcast_consume(ringbuffer_bcast_t *b, int id, size_t size) {
+    size_t c = atomic_load_explicit(&b->cursor[id].pos, memory_order_relaxed);
+    if( c >= RINGBUF_BCAST_EVICTED ) return -1;
+    return atomic_compare_exchange_strong_explicit(&b->cursor[id].pos, &c, c + size,
+                                                   memory_order_release, memory_order_relaxed) ? 0 : -1;
+}
+
+size_t ringbuffer_bcast_read(ringbuffer_bcast_t *b, int id, uint8_t *dst, size_t size) {
+    ringbuffer_span_t span[2];
+    size_t toread = ringbuffer_bcast_peek(b, id, size, span);
+    if( !toread ) return 0;
+    memcpy(dst, span[0].ptr, span[0].len);
+    if( span[1].len ) memcpy(dst + span[0].len, span[1].ptr, span[1].len);
+    return ringbuffer_bcast_consume(b, id, toread) < 0 ? 0 : toread;
+}
@@ -0,0 +1,57 @@
+#ifndef __voidlizard_ringbuf_bcast_h
+#define __voidlizard_ringbuf_bcast_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Broadcast: one producer, up to RINGBUF_BCAST_READERS readers, each
+   reading every byte from its own cursor (RINGBUF_MODE_SPSC|POW2 buffer).
+
+   The producer writes with ringbuffer_bcast_write(), or calls
+   ringbuffer_bcast_write_avail() before using the usual reserve/advance
+   or transactions on b->rb. When the buffer looks full it recomputes
+   rb->rcount as the slowest registered cursor, so free space is what
+   the slowest reader has released. With lag_max set, a reader more than
+   lag_max bytes behind at that point is evicted instead: its cursor is
+   dropped and its next consume/read fails, ringbuffer_bcast_evicted()
+   tells. Data read by an evicted reader may have been overwritten.
+
+   A reader joins at the oldest byte still held (join every reader before
+   the producer starts to see everything). Without readers the producer
+   never blocks and the data is lost. */
+
+#ifndef RINGBUF_BCAST_READERS
+#define RINGBUF_BCAST_READERS 8
+#endif
+
+/* one per reader: with RINGBUF_CACHELINE each sits on its own line, a
+   reader's consume does not invalidate the others or the producer's scan */
+typedef struct ringbuffer_bcast_cursor_t_ {
+    RINGBUF_ALIGNED RINGBUF_ATOMIC(size_t) pos;  /* bytes consumed */
+} ringbuffer_bcast_cursor_t;
+
+typedef struct ringbuffer_bcast_t_ {
+    ringbuffer_t              *rb;
+    size_t                    lag_max;    /* 0 = never evict */
+    ringbuffer_bcast_cursor_t cursor[RINGBUF_BCAST_READERS];
+} ringbuffer_bcast_t;
+
+int ringbuffer_bcast_init(ringbuffer_bcast_t *b, ringbuffer_t *rb, size_t lag_max);
+int ringbuffer_bcast_join(ringbuffer_bcast_t *b);
+void ringbuffer_bcast_leave(ringbuffer_bcast_t *b, int id);
+int ringbuffer_bcast_evicted(ringbuffer_bcast_t *b, int id);
+size_t ringbuffer_bcast_write_avail(ringbuffer_bcast_t *b, size_t want);
+size_t ringbuffer_bcast_write(ringbuffer_bcast_t *b, const uint8_t *src, size_t size);
+size_t ringbuffer_bcast_read_avail(ringbuffer_bcast_t *b, int id);
+size_t ringbuffer_bcast_peek(ringbuffer_bcast_t *b, int id, size_t size, ringbuffer_span_t span[2]);
+int ringbuffer_bcast_consume(ringbuffer_bcast_t *b, int id, size_t size);
+size_t ringbuffer_bcast_read(ringbuffer_bcast_t *b, int id, uint8_t *dst, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+
+#include "ringbuf_fd.h"
+
+#include <errno.h>
+#include <sys/uio.h>
+
+static int ringbuffer_iov(ringbuffer_span_t *span, struct iovec *iov) {
+    int cnt = 0;
+    int i = 0;
+    for(i = 0; i < 2; i++) {
+        if( !span[i].len ) continue;
+        iov[cnt].iov_base = span[i].ptr;
+        iov[cnt].iov_len  = span[i].len;
+        cnt++;
+    }
+    return cnt;
+}
+
+ssize_t ringbuffer_fill_from_fd(ringbuffer_t *rb, int fd) {
+    ringbuffer_span_t span[2];
+    struct iovec iov[2];
+    ssize_t n = 0;
+    size_t avail = ringbuffer_write_reserve(rb, SIZE_MAX, span);
+
+    if( avail < RINGBUF_FD_CHUNK ) avail = ringbuffer_write_reserve(rb, RINGBUF_FD_CHUNK, span);
+    if( !avail ) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    n = readv(fd, iov, ringbuffer_iov(span, iov));
+    if( n > 0 ) {
+        ringbuffer_write_advance(rb, (size_t)n);
+    }
+    return n;
+}
+
+ssize_t ringbuffer_drain_to_fd(ringbuffer_t *rb, int fd) {
+    ringbuffer_span_t span[2];
+    struct iovec iov[2];
+    ssize_t n = 0;
+
+    if( !ringbuffer_read_peek(rb, SIZE_MAX, span) ) {
+        return 0;
+    }
+
+    n = writev(fd, iov, ringbuffer_iov(span, iov));
+    if( n > 0 ) {
+        ringbuffer_read_consume(rb, (size_t)n);
+    }
+    return n;
+}
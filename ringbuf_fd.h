@@ -0,0 +1,31 @@
+#ifndef __voidlizard_ringbuf_fd_h
+#define __voidlizard_ringbuf_fd_h
+
+#include "ringbuf.h"
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Direct file descriptor I/O (POSIX). readv/writev go straight to the one
+   or two free/used regions of the buffer, no bounce buffer.
+
+   ringbuffer_fill_from_fd returns bytes read, 0 on EOF, -1 with errno set
+   on error; -1 with errno == ENOBUFS if the buffer has no free space.
+   ringbuffer_drain_to_fd returns bytes written (0 if the buffer is empty),
+   -1 with errno set on error. */
+
+/* an auto-grow buffer with less free space grows for one read of this size */
+#ifndef RINGBUF_FD_CHUNK
+#define RINGBUF_FD_CHUNK 4096
+#endif
+
+ssize_t ringbuffer_fill_from_fd(ringbuffer_t *rb, int fd);
+ssize_t ringbuffer_drain_to_fd(ringbuffer_t *rb, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
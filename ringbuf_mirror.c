@@ -0,0 +1,84 @@
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "ringbuf_mirror.h"
+
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+ringbuffer_t* ringbuffer_alloc_mirror(size_t data_size, uint8_t mode) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (data_size + page - 1) / page * page;
+    ringbuffer_t *rb = (ringbuffer_t*)0;
+    uint8_t *base = MAP_FAILED;
+    int fd = -1;
+
+    if( !size ) return (ringbuffer_t*)0;
+
+    /* the data lives in our own mapping, not in a shm region or malloc */
+    if( mode & (RINGBUF_MODE_SHM | RINGBUF_MODE_HEAP) ) return (ringbuffer_t*)0;
+
+    if( mode & RINGBUF_MODE_MPSC ) {
+        mode |= RINGBUF_MODE_POW2;
+    }
+
+    if( (mode & RINGBUF_MODE_POW2) && ringbuffer_pow2_floor(size) != size ) {
+        size = ringbuffer_pow2_floor(size) << 1;
+    }
+
+    rb = (ringbuffer_t*)aligned_alloc(_Alignof(ringbuffer_t), sizeof(ringbuffer_t));
+    if( !rb ) goto _fail;
+
+    fd = memfd_create("ringbuf", MFD_CLOEXEC);
+    if( fd < 0 || ftruncate(fd, (off_t)size) < 0 ) goto _fail;
+
+    /* reserve 2*size of address space, then put both views over it */
+    base = mmap(0, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if( base == MAP_FAILED ) goto _fail;
+
+    if( mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+     || mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ) {
+        goto _fail;
+    }
+
+    close(fd);
+
+    rb->data_size = size;
+    rb->mode = mode | RINGBUF_MODE_MIRROR;
+    rb->grow_max = 0;
+    rb->bs = base;
+    rb->be = base + size;
+    ringbuffer_reset(rb);
+    return rb;
+
+_fail:
+    if( base != MAP_FAILED ) munmap(base, 2 * size);
+    if( fd >= 0 ) close(fd);
+    free(rb);
+    return (ringbuffer_t*)0;
+}
+
+void ringbuffer_free_mirror(ringbuffer_t *rb) {
+    if( !rb ) return;
+    munmap(rb->bs, 2 * rb->data_size);
+    free(rb);
+}
+
+#else
+
+ringbuffer_t* ringbuffer_alloc_mirror(size_t data_size, uint8_t mode) {
+    return (ringbuffer_t*)0;
+}
+
+void ringbuffer_free_mirror(ringbuffer_t *rb) {
+}
+
+#endif
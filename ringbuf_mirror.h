@@ -0,0 +1,27 @@
+#ifndef __voidlizard_ringbuf_mirror_h
+#define __voidlizard_ringbuf_mirror_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* "Magic" ring buffer: the data region is mapped twice back to back, so
+   any readable or writable region is a single contiguous span even when
+   it crosses `be`. data_size is rounded up to the page size (and to a
+   power of two with RINGBUF_MODE_POW2). The header
+   is heap allocated, the data lives in the mapping.
+
+   RINGBUF_MODE_SHM and RINGBUF_MODE_HEAP are refused.
+
+   Linux only (memfd + mmap), returns 0 elsewhere or on failure. */
+
+ringbuffer_t* ringbuffer_alloc_mirror(size_t data_size, uint8_t mode);
+void ringbuffer_free_mirror(ringbuffer_t *rb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+
+#include "ringbuf_mpsc.h"
+
+#include <string.h>
+#include <stdatomic.h>
+
+#define RINGBUF_MPSC_HDR 4
+#define ringbuffer_mpsc_footprint(len) (RINGBUF_MPSC_HDR + (((len) + 3) & ~(size_t)3))
+
+static inline _Atomic uint32_t *ringbuffer_mpsc_hdr(ringbuffer_t *rb, size_t pos) {
+    return (_Atomic uint32_t*)(rb->bs + (pos & (rb->data_size - 1)));
+}
+
+size_t ringbuffer_mpsc_reserve(ringbuffer_t *rb, size_t len, ringbuffer_mpsc_slot_t *slot) {
+    size_t need = ringbuffer_mpsc_footprint(len);
+    size_t claim = atomic_load_explicit(&rb->wcount, memory_order_relaxed);
+
+    if( !len || len >= 0xFFFFFFFFul || need > rb->data_size ) return 0;
+
+    do {
+        size_t rcount = atomic_load_explicit(&rb->rcount, memory_order_acquire);
+        if( claim + need - rcount > rb->data_size ) return 0;
+    } while( !atomic_compare_exchange_weak_explicit(&rb->wcount, &claim, claim + need,
+                                                    memory_order_relaxed, memory_order_relaxed) );
+
+    slot->pos = claim;
+    slot->len = len;
+    ringbuffer_spans_at(rb, claim + RINGBUF_MPSC_HDR, len, slot->span);
+    return len;
+}
+
+void ringbuffer_mpsc_publish(ringbuffer_t *rb, ringbuffer_mpsc_slot_t *slot) {
+    atomic_store_explicit(ringbuffer_mpsc_hdr(rb, slot->pos), (uint32_t)(slot->len + 1), memory_order_release);
+}
+
+size_t ringbuffer_mpsc_write(ringbuffer_t *rb, const uint8_t *src, size_t len) {
+    ringbuffer_mpsc_slot_t slot;
+    if( !ringbuffer_mpsc_reserve(rb, len, &slot) ) return 0;
+    memcpy(slot.span[0].ptr, src, slot.span[0].len);
+    if( slot.span[1].len ) memcpy(slot.span[1].ptr, src + slot.span[0].len, slot.span[1].len);
+    ringbuffer_mpsc_publish(rb, &slot);
+    return len;
+}
+
+size_t ringbuffer_mpsc_peek_len(ringbuffer_t *rb) {
+    size_t pos = atomic_load_explicit(&rb->rcount, memory_order_relaxed);
+    uint32_t hdr = atomic_load_explicit(ringbuffer_mpsc_hdr(rb, pos), memory_order_acquire);
+    return hdr ? (size_t)hdr - 1 : 0;
+}
+
+size_t ringbuffer_mpsc_read(ringbuffer_t *rb, uint8_t *dst, size_t size) {
+    ringbuffer_span_t span[2];
+    size_t pos = atomic_load_explicit(&rb->rcount, memory_order_relaxed);
+    size_t len = ringbuffer_mpsc_peek_len(rb);
+    size_t need = ringbuffer_mpsc_footprint(len);
+
+    if( !len || len > size ) return 0;
+
+    ringbuffer_spans_at(rb, pos + RINGBUF_MPSC_HDR, len, span);
+    memcpy(dst, span[0].ptr, span[0].len);
+    if( span[1].len ) memcpy(dst + span[0].len, span[1].ptr, span[1].len);
+
+    /* hand the space back zeroed, any word in it may become a header */
+    ringbuffer_spans_at(rb, pos, need, span);
+    memset(span[0].ptr, 0, span[0].len);
+    if( span[1].len ) memset(span[1].ptr, 0, span[1].len);
+
+    atomic_store_explicit(&rb->rcount, pos + need, memory_order_release);
+    return len;
+}
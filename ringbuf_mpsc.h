@@ -0,0 +1,40 @@
+#ifndef __voidlizard_ringbuf_mpsc_h
+#define __voidlizard_ringbuf_mpsc_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Multi producer / single consumer records (RINGBUF_MODE_MPSC).
+
+   Producers claim space with a CAS on wcount, fill the payload in place
+   and publish their record independently of each other. Every record is a
+   32 bit header word followed by the payload padded to 4 bytes; the
+   header stays 0 until ringbuffer_mpsc_publish() stores the length. The
+   consumer walks the headers from rcount and stops at the first
+   unpublished one, so it only ever sees a contiguous published prefix.
+   Consumed records are zeroed before the space is handed back.
+
+   ringbuffer_alloc_mode() refuses a buffer whose data is not 4 byte
+   aligned. Only the ringbuffer_mpsc_* functions may be used on such a
+   buffer, transactions do not apply. */
+
+typedef struct ringbuffer_mpsc_slot_t_ {
+    size_t            pos;      /* wcount value of the header */
+    size_t            len;      /* payload length */
+    ringbuffer_span_t span[2];  /* payload */
+} ringbuffer_mpsc_slot_t;
+
+size_t ringbuffer_mpsc_reserve(ringbuffer_t *rb, size_t len, ringbuffer_mpsc_slot_t *slot);
+void ringbuffer_mpsc_publish(ringbuffer_t *rb, ringbuffer_mpsc_slot_t *slot);
+size_t ringbuffer_mpsc_write(ringbuffer_t *rb, const uint8_t *src, size_t len);
+size_t ringbuffer_mpsc_peek_len(ringbuffer_t *rb);
+size_t ringbuffer_mpsc_read(ringbuffer_t *rb, uint8_t *dst, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+
+#include "ringbuf_msg.h"
+
+#include <string.h>
+
+static size_t ringbuffer_msg_hdr_encode(uint8_t *hdr, size_t len) {
+    size_t n = 0;
+    do {
+        uint8_t b = (uint8_t)(len & 0x7F);
+        len >>= 7;
+        hdr[n++] = len ? (b | 0x80) : b;
+    } while( len );
+    return n;
+}
+
+/* 0 if the header is incomplete or invalid */
+static size_t ringbuffer_msg_hdr_decode(const uint8_t *p, size_t avail, size_t *len) {
+    size_t n = 0, v = 0;
+    for(n = 0; n < avail && n < RINGBUF_MSG_HDR_MAX; n++) {
+        v |= (size_t)(p[n] & 0x7F) << (7 * n);
+        if( !(p[n] & 0x80) ) {
+            *len = v;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+/* copies len bytes to/from offset off of a two span region */
+static void ringbuffer_msg_put(ringbuffer_span_t *span, size_t off, const uint8_t *src, size_t len) {
+    int i = 0;
+    for(i = 0; i < 2 && len; i++) {
+        size_t n = 0;
+        if( off >= span[i].len ) {
+            off -= span[i].len;
+            continue;
+        }
+        n = span[i].len - off < len ? span[i].len - off : len;
+        memcpy(span[i].ptr + off, src, n);
+        src += n;
+        len -= n;
+        off = 0;
+    }
+}
+
+static void ringbuffer_msg_get(ringbuffer_span_t *span, size_t off, uint8_t *dst, size_t len) {
+    int i = 0;
+    for(i = 0; i < 2 && len; i++) {
+        size_t n = 0;
+        if( off >= span[i].len ) {
+            off -= span[i].len;
+            continue;
+        }
+        n = span[i].len - off < len ? span[i].len - off : len;
+        memcpy(dst, span[i].ptr + off, n);
+        dst += n;
+        len -= n;
+        off = 0;
+    }
+}
+
+static size_t ringbuffer_msg_next(ringbuffer_t *rb, ringbuffer_span_t *span, size_t *len);
+
+/* RINGBUF_OVERWRITE: drops the oldest whole record, 0 if there is none */
+static int ringbuffer_msg_drop(ringbuffer_t *rb) {
+    ringbuffer_span_t span[2];
+    size_t len = 0;
+    size_t hlen = 0;
+
+    if( !ringbuffer_overwrite_mode(rb) ) return 0;
+
+    hlen = ringbuffer_msg_next(rb, span, &len);
+    if( !hlen ) return 0;
+    ringbuffer_read_consume(rb, hlen + len);
+    rb->overrun += hlen + len;
+    return 1;
+}
+
+size_t ringbuffer_msg_write(ringbuffer_t *rb, const uint8_t *src, size_t len) {
+    ringbuffer_span_t span[2];
+    uint8_t hdr[RINGBUF_MSG_HDR_MAX];
+    size_t hlen = 0, pad = 0, avail = 0, cap = 0;
+
+    if( !len || len > RINGBUF_MSG_LEN_MAX ) return 0;
+
+    hlen = ringbuffer_msg_hdr_encode(hdr, len);
+    cap = rb->grow_max > rb->data_size ? rb->grow_max : rb->data_size;
+    if( hlen + len > cap - rb->twritten ) return 0;
+
+    for(;;) {
+        /* the record plus the worst case padding, an auto-grow buffer
+           grows for that much and no more */
+        avail = ringbuffer_write_reserve(rb, 2 * hlen - 1 + len, span);
+        pad = span[0].len < hlen && span[1].len ? span[0].len : 0;
+        if( pad + hlen + len <= avail ) break;
+        if( !ringbuffer_msg_drop(rb) ) return 0;
+    }
+
+    if( pad ) memset(span[0].ptr, 0, pad);
+    ringbuffer_msg_put(span, pad, hdr, hlen);
+    ringbuffer_msg_put(span, pad + hlen, src, len);
+    ringbuffer_write_advance(rb, pad + hlen + len);
+
+    return len;
+}
+
+/* skips the padding in front of be and decodes the next header,
+   returns header size or 0 if there is no complete record */
+static size_t ringbuffer_msg_next(ringbuffer_t *rb, ringbuffer_span_t *span, size_t *len) {
+    size_t avail = ringbuffer_read_peek(rb, SIZE_MAX, span);
+    size_t hlen = 0;
+
+    if( avail && !span[0].ptr[0] ) {
+        ringbuffer_read_consume(rb, span[0].len);
+        avail = ringbuffer_read_peek(rb, SIZE_MAX, span);
+    }
+
+    if( !avail ) return 0;
+
+    hlen = ringbuffer_msg_hdr_decode(span[0].ptr, span[0].len, len);
+    if( !hlen || hlen + *len > avail ) return 0;
+    return hlen;
+}
+
+size_t ringbuffer_msg_peek_len(ringbuffer_t *rb) {
+    ringbuffer_span_t span[2];
+    size_t len = 0;
+    return ringbuffer_msg_next(rb, span, &len) ? len : 0;
+}
+
+size_t ringbuffer_msg_read(ringbuffer_t *rb, uint8_t *dst, size_t size) {
+    ringbuffer_span_t span[2];
+    size_t len = 0;
+    size_t hlen = ringbuffer_msg_next(rb, span, &len);
+
+    if( !hlen || len > size ) return 0;
+
+    ringbuffer_msg_get(span, hlen, dst, len);
+    ringbuffer_read_consume(rb, hlen + len);
+    return len;
+}
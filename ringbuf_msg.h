@@ -0,0 +1,40 @@
+#ifndef __voidlizard_ringbuf_msg_h
+#define __voidlizard_ringbuf_msg_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Length prefixed records on top of ringbuffer_t.
+
+   Each record is a LEB128 length (1..5 bytes) followed by the payload.
+   A header is never split across `be`: if it does not fit in front of be
+   the gap is filled with zero bytes (a zero length is never a valid
+   header) and the record starts at bs. The payload may wrap.
+
+   ringbuffer_msg_write writes the whole record or nothing and publishes it
+   with a single advance, so with RINGBUF_AUTOCOMMIT off a record takes
+   part in the current transaction like any other write.
+
+   ringbuffer_msg_peek_len returns the payload length of the next record,
+   0 if there is none. ringbuffer_msg_read copies out one whole record and
+   returns its length; it returns 0 and leaves the record in place if
+   dst is too small.
+
+   With RINGBUF_OVERWRITE ringbuffer_msg_write drops the oldest whole
+   records until the new one fits; dropped bytes go to the overrun counter. */
+
+#define RINGBUF_MSG_HDR_MAX 5
+#define RINGBUF_MSG_LEN_MAX 0xFFFFFFFFul
+
+size_t ringbuffer_msg_write(ringbuffer_t *rb, const uint8_t *src, size_t len);
+size_t ringbuffer_msg_peek_len(ringbuffer_t *rb);
+size_t ringbuffer_msg_read(ringbuffer_t *rb, uint8_t *dst, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,3 +1,4 @@
+
 #ifndef __voidlizard_ringbuf_setup_h
 #define __voidlizard_ringbuf_setup_h
 
@@ -9,5 +10,39 @@
 #define RINGBUF_DEFAULT_FLAGS RINGBUF_AUTOCOMMIT
 #endif
 
+/* Define RINGBUF_NO_ATOMICS on targets without C11 atomics.
+   RINGBUF_MODE_SPSC is not available then. C++ sees the same fields as
+   std::atomic, which has the layout of _Atomic for lock-free types. */
+#if defined(RINGBUF_NO_ATOMICS)
+#define RINGBUF_ATOMIC(T) T
+#elif defined(__cplusplus)
+#include <atomic>
+#define RINGBUF_ATOMIC(T) std::atomic<T>
+#else
+#define RINGBUF_ATOMIC(T) _Atomic(T)
+#endif
+
+/* Define RINGBUF_CACHELINE (e.g. 64) to put the producer owned and the
+   consumer owned fields of ringbuffer_t on separate cache lines.
+   ringbuffer_alloc() aligns the caller's array, RINGBUF_ALLOC_SIZE()
+   reserves the slack for that. */
+#if defined(RINGBUF_CACHELINE) && defined(__cplusplus)
+#define RINGBUF_ALIGNED alignas(RINGBUF_CACHELINE)
+#define RINGBUF_ALLOC_SLACK (RINGBUF_CACHELINE - 1)
+#elif defined(RINGBUF_CACHELINE)
+#define RINGBUF_ALIGNED _Alignas(RINGBUF_CACHELINE)
+#define RINGBUF_ALLOC_SLACK (RINGBUF_CACHELINE - 1)
+#else
+#define RINGBUF_ALIGNED
+#define RINGBUF_ALLOC_SLACK 0
+#endif
+
+/* Define RINGBUF_NO_HEAP on targets without malloc: removes
+   ringbuffer_new/free/resize and auto-grow. */
+
+/* Define RINGBUF_STATS to count traffic in every ringbuffer_t, read
+   with ringbuffer_stats(). Without it the counters and their updates
+   are compiled out and ringbuffer_stats() returns zeros. */
+
 #endif
 
@@ -0,0 +1,384 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "ringbuf_shm.h"
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+/* the ring starts on its own cache line after the header */
+#define RINGBUF_SHM_RB_OFF ((sizeof(ringbuffer_shm_hdr_t) + 63) & ~(size_t)63)
+
+static int ringbuffer_shm_pid_alive(int32_t pid) {
+    return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+}
+
+/* a new owner of a dead side's role: forget what it had not published */
+static void ringbuffer_shm_recover(ringbuffer_t *rb, int role) {
+    if( role == RINGBUF_SHM_PRODUCER ) {
+        rb->twritten = 0;
+        rb->flags |= rb->wbatch;
+        rb->wbatch = 0;
+    } else {
+        rb->tread = 0;
+        rb->rbatch = 0;
+    }
+}
+
+static void ringbuffer_shm_layout(ringbuffer_shm_layout_t *l) {
+    memset(l, 0, sizeof(*l));
+    l->rb_size = (uint16_t)sizeof(ringbuffer_t);
+    l->wcount_off = (uint16_t)offsetof(ringbuffer_t, wcount);
+    l->rcount_off = (uint16_t)offsetof(ringbuffer_t, rcount);
+    l->data_off = (uint16_t)offsetof(ringbuffer_t, data);
+    l->ptr_size = (uint8_t)sizeof(void*);
+    l->size_size = (uint8_t)sizeof(size_t);
+#ifdef RINGBUF_STATS
+    l->stats = 1;
+#endif
+#ifdef RINGBUF_CACHELINE
+    l->cacheline = RINGBUF_CACHELINE;
+#endif
+}
+
+/* tells a reopen after a reboot (page cache lost) from one after a crash */
+static void ringbuffer_shm_boot_id(char id[40]) {
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+    memset(id, 0, 40);
+    if( fd < 0 ) return;
+    if( read(fd, id, 36) < 0 ) memset(id, 0, 40);
+    close(fd);
+}
+
+/* Only what ringbuffer_shm_sync() recorded is known to be on disk. The
+   producer writes no further than the published rcount + data_size and
+   a consumer in a read batch records before it publishes, so the bytes
+   from the durable rcount to the durable wcount are intact */
+static void ringbuffer_shm_reboot(ringbuffer_shm_hdr_t *hdr, ringbuffer_t *rb, const char boot[40]) {
+    uint64_t w = hdr->durable_wcount;
+    uint64_t r = hdr->durable_rcount;
+    if( r > w ) w = r;
+    if( w - r > rb->data_size ) r = w - rb->data_size;
+    atomic_store(&hdr->pid[RINGBUF_SHM_PRODUCER], 0);
+    atomic_store(&hdr->pid[RINGBUF_SHM_CONSUMER], 0);
+    atomic_store(&rb->wcount, (size_t)w);
+    atomic_store(&rb->rcount, (size_t)r);
+    rb->rcount_cache = (size_t)r;
+    rb->wcount_cache = (size_t)w;
+    ringbuffer_shm_recover(rb, RINGBUF_SHM_PRODUCER);
+    ringbuffer_shm_recover(rb, RINGBUF_SHM_CONSUMER);
+    hdr->durable_wcount = w;
+    hdr->durable_rcount = r;
+    memcpy(hdr->boot_id, boot, sizeof(hdr->boot_id));
+}
+
+static int ringbuffer_shm_claim(ringbuffer_shm_t *s, int role) {
+    int32_t me = (int32_t)getpid();
+    int32_t cur = 0;
+    while( !atomic_compare_exchange_strong(&s->hdr->pid[role], &cur, me) ) {
+        if( cur == me || ringbuffer_shm_pid_alive(cur) ) {
+            errno = EBUSY;
+            return -1;
+        }
+    }
+    if( cur ) ringbuffer_shm_recover(s->rb, role);
+    s->role = role;
+    return 0;
+}
+
+/* lays out a new ring in fd, which the caller has just created */
+static int ringbuffer_shm_init_fd(ringbuffer_shm_t *s, int fd, size_t data_size, int role) {
+    size_t size = ringbuffer_pow2_floor(data_size);
+    uint8_t *base = MAP_FAILED;
+    int err = 0;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+
+    if( role != RINGBUF_SHM_PRODUCER && role != RINGBUF_SHM_CONSUMER ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if( size != data_size ) size <<= 1;
+    if( !size ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s->map_size = RINGBUF_SHM_RB_OFF + RINGBUF_ALLOC_SIZE(size);
+    if( ftruncate(fd, (off_t)s->map_size) < 0 ) goto _fail;
+
+    base = mmap(0, s->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( base == MAP_FAILED ) goto _fail;
+
+    s->hdr = (ringbuffer_shm_hdr_t*)base;
+    s->rb = ringbuffer_alloc_mode(s->map_size - RINGBUF_SHM_RB_OFF, base + RINGBUF_SHM_RB_OFF, RINGBUF_MODE_SHM);
+    if( !s->rb || s->rb->data_size != size ) {
+        errno = EINVAL;
+        goto _fail;
+    }
+
+    s->hdr->version = RINGBUF_SHM_VERSION;
+    ringbuffer_shm_layout(&s->hdr->layout);
+    s->hdr->map_size = s->map_size;
+    s->hdr->rb_off = (uint64_t)((uint8_t*)s->rb - base);
+    s->hdr->durable_wcount = 0;
+    s->hdr->durable_rcount = 0;
+    ringbuffer_shm_boot_id(s->hdr->boot_id);
+    atomic_init(&s->hdr->pid[RINGBUF_SHM_PRODUCER], 0);
+    atomic_init(&s->hdr->pid[RINGBUF_SHM_CONSUMER], 0);
+    atomic_store(&s->hdr->pid[role], (int32_t)getpid());
+    s->role = role;
+    s->fd = fd;
+
+    /* the magic goes last, attach() checks it before anything else */
+    atomic_thread_fence(memory_order_release);
+    s->hdr->magic = RINGBUF_SHM_MAGIC;
+    return 0;
+
+_fail:
+    err = errno;
+    if( base != MAP_FAILED ) munmap(base, s->map_size);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    errno = err;
+    return -1;
+}
+
+int ringbuffer_shm_create(ringbuffer_shm_t *s, const char *name, size_t data_size, int role) {
+    int fd = name ? shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600)
+                  : memfd_create("ringbuf_shm", MFD_CLOEXEC);
+    int err = 0;
+
+    if( fd >= 0 && ringbuffer_shm_init_fd(s, fd, data_size, role) == 0 ) return 0;
+
+    err = errno;
+    if( fd >= 0 ) close(fd);
+    if( name && fd >= 0 ) shm_unlink(name);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    errno = err;
+    return -1;
+}
+
+int ringbuffer_shm_attach_fd(ringbuffer_shm_t *s, int fd, int role) {
+    ringbuffer_shm_hdr_t *hdr = (ringbuffer_shm_hdr_t*)0;
+    uint8_t *base = MAP_FAILED;
+    ringbuffer_shm_layout_t layout;
+    struct stat st;
+    char boot[40];
+    int err = 0;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+
+    if( role != RINGBUF_SHM_PRODUCER && role != RINGBUF_SHM_CONSUMER ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if( fstat(fd, &st) < 0 ) return -1;
+    if( (size_t)st.st_size < RINGBUF_SHM_RB_OFF + sizeof(ringbuffer_t) ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s->map_size = (size_t)st.st_size;
+    base = mmap(0, s->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( base == MAP_FAILED ) return -1;
+
+    hdr = (ringbuffer_shm_hdr_t*)base;
+    if( hdr->magic != RINGBUF_SHM_MAGIC ) {
+        errno = EINVAL;
+        goto _fail;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    ringbuffer_shm_layout(&layout);
+    if( hdr->version != RINGBUF_SHM_VERSION || memcmp(&hdr->layout, &layout, sizeof(layout)) ) {
+        errno = EPROTO;
+        goto _fail;
+    }
+    if( hdr->map_size != s->map_size || hdr->rb_off > s->map_size - sizeof(ringbuffer_t) ) {
+        errno = EINVAL;
+        goto _fail;
+    }
+
+    s->hdr = hdr;
+    s->rb = (ringbuffer_t*)(base + hdr->rb_off);
+    if( !(s->rb->mode & RINGBUF_MODE_SHM)
+     || ringbuffer_pow2_floor(s->rb->data_size) != s->rb->data_size
+     || s->rb->data_size > s->map_size - hdr->rb_off - sizeof(ringbuffer_t) + 1 ) {
+        errno = EINVAL;
+        goto _fail;
+    }
+
+    ringbuffer_shm_boot_id(boot);
+    if( memcmp(hdr->boot_id, boot, sizeof(boot)) ) ringbuffer_shm_reboot(hdr, s->rb, boot);
+
+    s->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if( s->fd < 0 || ringbuffer_shm_claim(s, role) < 0 ) goto _fail;
+    return 0;
+
+_fail:
+    err = errno;
+    munmap(base, s->map_size);
+    if( s->fd >= 0 ) close(s->fd);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    errno = err;
+    return -1;
+}
+
+int ringbuffer_shm_attach(ringbuffer_shm_t *s, const char *name, int role) {
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    int res = -1, err = 0;
+    if( fd < 0 ) return -1;
+    res = ringbuffer_shm_attach_fd(s, fd, role);
+    err = errno;
+    close(fd);
+    errno = err;
+    return res;
+}
+
+void ringbuffer_shm_detach(ringbuffer_shm_t *s) {
+    if( s->hdr ) {
+        int32_t me = (int32_t)getpid();
+        atomic_compare_exchange_strong(&s->hdr->pid[s->role], &me, 0);
+        munmap(s->hdr, s->map_size);
+    }
+    if( s->fd >= 0 ) close(s->fd);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+}
+
+int ringbuffer_shm_unlink(const char *name) {
+    return shm_unlink(name);
+}
+
+int ringbuffer_shm_peer_alive(ringbuffer_shm_t *s) {
+    int32_t pid = atomic_load(&s->hdr->pid[!s->role]);
+    return pid && ringbuffer_shm_pid_alive(pid);
+}
+
+int ringbuffer_shm_open_file(ringbuffer_shm_t *s, const char *path, size_t data_size, int role) {
+    struct stat st;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    int res = -1, err = 0;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    if( fd < 0 ) return -1;
+
+    /* serialises the first creation and the reset after a reboot */
+    if( flock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0 ) {
+        if( st.st_size ) {
+            res = ringbuffer_shm_attach_fd(s, fd, role);
+        } else if( ringbuffer_shm_init_fd(s, fd, data_size, role) == 0 ) {
+            if( fsync(fd) == 0 ) {
+                flock(fd, LOCK_UN);
+                return 0;
+            }
+            err = errno;
+            munmap(s->hdr, s->map_size);
+            memset(s, 0, sizeof(*s));
+            s->fd = -1;
+            errno = err;
+        }
+    }
+
+    err = errno;
+    flock(fd, LOCK_UN);
+    close(fd);
+    errno = err;
+    return res;
+}
+
+static int ringbuffer_shm_msync(void *addr, size_t len) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t skew = (uintptr_t)addr & (page - 1);
+    return msync((uint8_t*)addr - skew, len + skew, MS_SYNC);
+}
+
+int ringbuffer_shm_sync(ringbuffer_shm_t *s) {
+    ringbuffer_t *rb = s->rb;
+
+    if( s->role == RINGBUF_SHM_PRODUCER ) {
+        size_t w = atomic_load_explicit(&rb->wcount, memory_order_relaxed);
+        size_t d = (size_t)s->hdr->durable_wcount;
+        size_t off = d & (rb->data_size - 1);
+        size_t len = w - d;
+
+        if( !len ) return 0;
+        /* the data first, the counter that makes it visible after it */
+        if( len >= rb->data_size ) {
+            if( ringbuffer_shm_msync(rb->data, rb->data_size) < 0 ) return -1;
+        } else if( off + len > rb->data_size ) {
+            if( ringbuffer_shm_msync(rb->data + off, rb->data_size - off) < 0 ) return -1;
+            if( ringbuffer_shm_msync(rb->data, off + len - rb->data_size) < 0 ) return -1;
+        } else if( ringbuffer_shm_msync(rb->data + off, len) < 0 ) {
+            return -1;
+        }
+        s->hdr->durable_wcount = w;
+    } else {
+        size_t r = atomic_load_explicit(&rb->rcount, memory_order_relaxed) + rb->tread;
+        if( r == s->hdr->durable_rcount ) return 0;
+        s->hdr->durable_rcount = r;
+    }
+
+    return ringbuffer_shm_msync(s->hdr, sizeof(*s->hdr));
+}
+
+#else
+
+int ringbuffer_shm_create(ringbuffer_shm_t *s, const char *name, size_t data_size, int role) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int ringbuffer_shm_attach(ringbuffer_shm_t *s, const char *name, int role) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int ringbuffer_shm_attach_fd(ringbuffer_shm_t *s, int fd, int role) {
+    errno = ENOSYS;
+    return -1;
+}
+
+void ringbuffer_shm_detach(ringbuffer_shm_t *s) {
+}
+
+int ringbuffer_shm_unlink(const char *name) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int ringbuffer_shm_peer_alive(ringbuffer_shm_t *s) {
+    return 0;
+}
+
+int ringbuffer_shm_open_file(ringbuffer_shm_t *s, const char *path, size_t data_size, int role) {
+    errno = ENOSYS;
+    return -1;
+}
+
+int ringbuffer_shm_sync(ringbuffer_shm_t *s) {
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __voidlizard_ringbuf_shm_h
+#define __voidlizard_ringbuf_shm_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* SPSC ring shared between two processes (Linux: shm_open / memfd).
+
+   The mapping is a small header followed by an ordinary ringbuffer_t
+   allocated with RINGBUF_MODE_SHM: positions are the wcount/rcount
+   counters and the data is addressed relative to the header, so every
+   process may map the region at any address. The header records the
+   offset of the ring, a magic and a layout version checked at attach.
+   Both processes must see the same ringbuffer_t: the header also keeps
+   its size and field offsets as built by the creator, plus the
+   RINGBUF_STATS/RINGBUF_CACHELINE settings, and attach refuses
+   (EPROTO) a region from a differently built peer.
+
+   Each side attaches with a role. The role slot holds the owner pid,
+   ringbuffer_shm_peer_alive() checks the other one with kill(pid, 0).
+   A slot whose owner died may be taken over by a new attach, which
+   drops the dead side's uncommitted writes / unpublished batch reads.
+   Pid reuse is not detected, an unreaped zombie still counts as alive.
+
+   name == 0 creates an anonymous memfd region, pass s->fd to the peer
+   (fork, SCM_RIGHTS) and attach it with ringbuffer_shm_attach_fd().
+
+   create/attach/unlink return 0 or -1 with errno set. Only the ringbuffer_t
+   data path is shared, ringbuf_wait.h is process private.
+
+   ringbuffer_shm_open_file() keeps the same layout in a regular file,
+   created on first use. Committed data is in the page cache and survives
+   a crash of either process as above. For a machine crash each side
+   calls ringbuffer_shm_sync() at its durability points (after a commit
+   or a batch of reads): the producer msyncs the new data, then records
+   wcount in the header, the consumer records rcount. An open in a new
+   boot (header boot_id differs) rolls both counters back to the last
+   recorded ones: what was synced is replayed, the rest is gone. The
+   consumer reads in a read batch and syncs before ringbuffer_read_batch_end(),
+   otherwise the producer may reuse space the header still counts as
+   unread. Delivery is at least once. An existing file keeps its size,
+   data_size only applies to a new one. A file outlives the binary that
+   wrote it: the layout check above also applies, a build with another
+   ringbuffer_t (RINGBUF_STATS, RINGBUF_CACHELINE, pointer width) gets
+   EPROTO instead of misreading the counters. */
+
+#define RINGBUF_SHM_MAGIC    0x68736272u   /* "rbsh" */
+#define RINGBUF_SHM_VERSION  3
+
+#define RINGBUF_SHM_PRODUCER 0
+#define RINGBUF_SHM_CONSUMER 1
+
+/* ringbuffer_t as the creating build laid it out */
+typedef struct ringbuffer_shm_layout_t_ {
+    uint16_t rb_size;
+    uint16_t wcount_off;
+    uint16_t rcount_off;
+    uint16_t data_off;
+    uint8_t  ptr_size;
+    uint8_t  size_size;
+    uint8_t  stats;      /* RINGBUF_STATS */
+    uint8_t  reserved;
+    uint16_t cacheline;  /* RINGBUF_CACHELINE, 0 = packed */
+    uint16_t reserved2;
+} ringbuffer_shm_layout_t;
+
+typedef struct ringbuffer_shm_hdr_t_ {
+    uint32_t                magic;
+    uint32_t                version;
+    ringbuffer_shm_layout_t layout;
+    uint64_t                map_size;
+    uint64_t                rb_off;     /* ringbuffer_t, from the start of the mapping */
+    RINGBUF_ATOMIC(int32_t) pid[2];     /* per role, 0 = detached */
+    uint64_t                durable_wcount; /* ringbuffer_shm_sync() */
+    uint64_t                durable_rcount;
+    char                    boot_id[40];
+} ringbuffer_shm_hdr_t;
+
+typedef struct ringbuffer_shm_t_ {
+    ringbuffer_shm_hdr_t *hdr;
+    ringbuffer_t         *rb;
+    size_t               map_size;
+    int                  fd;
+    int                  role;
+} ringbuffer_shm_t;
+
+int ringbuffer_shm_create(ringbuffer_shm_t *s, const char *name, size_t data_size, int role);
+int ringbuffer_shm_attach(ringbuffer_shm_t *s, const char *name, int role);
+int ringbuffer_shm_attach_fd(ringbuffer_shm_t *s, int fd, int role);
+void ringbuffer_shm_detach(ringbuffer_shm_t *s);
+int ringbuffer_shm_unlink(const char *name);
+int ringbuffer_shm_peer_alive(ringbuffer_shm_t *s);
+int ringbuffer_shm_open_file(ringbuffer_shm_t *s, const char *path, size_t data_size, int role);
+int ringbuffer_shm_sync(ringbuffer_shm_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
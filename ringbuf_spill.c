@@ -0,0 +1,176 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "ringbuf_spill.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+#define RINGBUF_SPILL_NOSEG ((uint64_t)-1)
+
+static int ringbuffer_spill_open(const char *dir) {
+    char path[4096];
+    int fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if( fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR) ) return fd;
+    /* no O_TMPFILE on this filesystem */
+    if( snprintf(path, sizeof(path), "%s/ringbuf_spill.XXXXXX", dir) >= (int)sizeof(path) ) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = mkostemp(path, O_CLOEXEC);
+    if( fd >= 0 ) unlink(path);
+    return fd;
+}
+
+int ringbuffer_spill_init(ringbuffer_spill_t *s, ringbuffer_t *rb, const char *dir, size_t seg_size, uint64_t spill_max) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+    s->rb = rb;
+    s->seg_size = (seg_size + page - 1) / page * page;
+    s->spill_max = spill_max;
+    s->wseg = RINGBUF_SPILL_NOSEG;
+    s->rseg = RINGBUF_SPILL_NOSEG;
+    atomic_init(&s->wpos, 0);
+    atomic_init(&s->rpos, 0);
+    if( !s->seg_size ) {
+        errno = EINVAL;
+        return -1;
+    }
+    s->fd = ringbuffer_spill_open(dir);
+    return s->fd < 0 ? -1 : 0;
+}
+
+void ringbuffer_spill_destroy(ringbuffer_spill_t *s) {
+    if( s->wmap ) munmap(s->wmap, s->seg_size);
+    if( s->rmap ) munmap(s->rmap, s->seg_size);
+    if( s->fd >= 0 ) close(s->fd);
+    s->wmap = s->rmap = 0;
+    s->fd = -1;
+}
+
+/* each side keeps one segment mapped and moves it along */
+static uint8_t *ringbuffer_spill_map(ringbuffer_spill_t *s, uint8_t **map, uint64_t *mseg, uint64_t seg) {
+    if( *mseg == seg ) return *map;
+    if( *map ) munmap(*map, s->seg_size);
+    *map = (uint8_t*)mmap(0, s->seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, (off_t)(seg * s->seg_size));
+    if( *map == MAP_FAILED ) {
+        *map = 0;
+        *mseg = RINGBUF_SPILL_NOSEG;
+        return 0;
+    }
+    *mseg = seg;
+    return *map;
+}
+
+static size_t ringbuffer_spill_append(ringbuffer_spill_t *s, const uint8_t *src, size_t size) {
+    uint64_t w = atomic_load_explicit(&s->wpos, memory_order_relaxed);
+    uint64_t r = atomic_load_explicit(&s->rpos, memory_order_acquire);
+    size_t done = 0;
+
+    if( w - r >= s->spill_max ) return 0;
+    if( size > s->spill_max - (w - r) ) size = (size_t)(s->spill_max - (w - r));
+
+    while( done < size ) {
+        uint64_t seg = (w + done) / s->seg_size;
+        size_t off = (size_t)((w + done) % s->seg_size);
+        size_t chunk = size - done < s->seg_size - off ? size - done : s->seg_size - off;
+        uint8_t *map = (uint8_t*)0;
+        /* reserve the blocks up front: a sparse segment on a full disk
+           would SIGBUS on the memcpy instead of a short write */
+        if( s->wseg != seg && posix_fallocate(s->fd, (off_t)(seg * s->seg_size), (off_t)s->seg_size) != 0 ) break;
+        map = ringbuffer_spill_map(s, &s->wmap, &s->wseg, seg);
+        if( !map ) break;
+        memcpy(map + off, src + done, chunk);
+        done += chunk;
+    }
+
+    atomic_store_explicit(&s->wpos, w + done, memory_order_release);
+    return done;
+}
+
+size_t ringbuffer_spill_write(ringbuffer_spill_t *s, const uint8_t *src, size_t size) {
+    size_t n = 0;
+    if( s->spilling ) {
+        /* back to the ring only once the reader has caught up */
+        if( atomic_load_explicit(&s->rpos, memory_order_acquire) != atomic_load_explicit(&s->wpos, memory_order_relaxed) ) {
+            return ringbuffer_spill_append(s, src, size);
+        }
+        s->spilling = 0;
+    }
+    n = ringbuffer_write(s->rb, src, size);
+    if( n == size ) return n;
+    s->spilling = 1;
+    return n + ringbuffer_spill_append(s, src + n, size - n);
+}
+
+size_t ringbuffer_spill_read(ringbuffer_spill_t *s, uint8_t *dst, size_t size) {
+    /* wpos first: the ring bytes written before the spill are then
+       visible too, and they go out first */
+    uint64_t w = atomic_load_explicit(&s->wpos, memory_order_acquire);
+    uint64_t r = atomic_load_explicit(&s->rpos, memory_order_relaxed);
+    size_t n = ringbuffer_read(s->rb, dst, size);
+    size_t done = 0;
+
+    if( n || w == r ) return n;
+    if( size > w - r ) size = (size_t)(w - r);
+
+    while( done < size ) {
+        uint64_t seg = (r + done) / s->seg_size;
+        size_t off = (size_t)((r + done) % s->seg_size);
+        size_t chunk = size - done < s->seg_size - off ? size - done : s->seg_size - off;
+        uint8_t *map = (uint8_t*)0;
+        if( s->rseg != RINGBUF_SPILL_NOSEG && s->rseg != seg ) {
+            /* the previous segment is drained, give the disk space back */
+            fallocate(s->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)(s->rseg * s->seg_size), (off_t)s->seg_size);
+        }
+        map = ringbuffer_spill_map(s, &s->rmap, &s->rseg, seg);
+        if( !map ) break;
+        memcpy(dst + done, map + off, chunk);
+        done += chunk;
+    }
+
+    atomic_store_explicit(&s->rpos, r + done, memory_order_release);
+    return done;
+}
+
+uint64_t ringbuffer_spill_pending(ringbuffer_spill_t *s) {
+    uint64_t r = atomic_load_explicit(&s->rpos, memory_order_acquire);
+    return atomic_load_explicit(&s->wpos, memory_order_acquire) - r;
+}
+
+#else
+
+int ringbuffer_spill_init(ringbuffer_spill_t *s, ringbuffer_t *rb, const char *dir, size_t seg_size, uint64_t spill_max) {
+    errno = ENOSYS;
+    return -1;
+}
+
+void ringbuffer_spill_destroy(ringbuffer_spill_t *s) {
+}
+
+size_t ringbuffer_spill_write(ringbuffer_spill_t *s, const uint8_t *src, size_t size) {
+    return 0;
+}
+
+size_t ringbuffer_spill_read(ringbuffer_spill_t *s, uint8_t *dst, size_t size) {
+    return 0;
+}
+
+uint64_t ringbuffer_spill_pending(ringbuffer_spill_t *s) {
+    return 0;
+}
+
+#endif
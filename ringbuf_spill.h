@@ -0,0 +1,50 @@
+#ifndef __voidlizard_ringbuf_spill_h
+#define __voidlizard_ringbuf_spill_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Disk spill tier behind an in-memory buffer (Linux).
+
+   ringbuffer_spill_write() writes to rb while it has room. What does not
+   fit is appended to an unlinked file in `dir`, mapped seg_size bytes at
+   a time, and from then on every write goes to the file until the reader
+   has drained it, so the order is kept. ringbuffer_spill_read() returns
+   the ring contents first (all older than anything spilled), then the
+   file. Drained segments are punched out of the file, disk use follows
+   the backlog. Writes are short only when spill_max bytes are pending.
+
+   With a RINGBUF_MODE_SPSC buffer one producer and one consumer thread
+   may use write and read concurrently. rb must stay in autocommit mode.
+   init returns 0 or -1 with errno set. */
+
+typedef struct ringbuffer_spill_t_ {
+    ringbuffer_t              *rb;
+    int                       fd;
+    size_t                    seg_size;
+    uint64_t                  spill_max;
+    /* producer side */
+    RINGBUF_ATOMIC(uint64_t)  wpos;      /* bytes appended to the file */
+    uint8_t                   *wmap;
+    uint64_t                  wseg;
+    uint8_t                   spilling;
+    /* consumer side */
+    RINGBUF_ALIGNED RINGBUF_ATOMIC(uint64_t) rpos;  /* bytes drained from the file */
+    uint8_t                   *rmap;
+    uint64_t                  rseg;
+} ringbuffer_spill_t;
+
+int ringbuffer_spill_init(ringbuffer_spill_t *s, ringbuffer_t *rb, const char *dir, size_t seg_size, uint64_t spill_max);
+void ringbuffer_spill_destroy(ringbuffer_spill_t *s);
+size_t ringbuffer_spill_write(ringbuffer_spill_t *s, const uint8_t *src, size_t size);
+size_t ringbuffer_spill_read(ringbuffer_spill_t *s, uint8_t *dst, size_t size);
+uint64_t ringbuffer_spill_pending(ringbuffer_spill_t *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef __voidlizard_ringbuf_static_h
+#define __voidlizard_ringbuf_static_h
+
+#include <stddef.h>
+#include <string.h>
+
+/* Header only typed ring with compile time capacity.
+
+    RINGBUF_DEFINE(samples, int16_t, 1024)
+
+   defines samples_t and static inline samples_init/_write_avail/
+   _read_avail/_push/_pop/_write/_read/_peek. N must be a power of two,
+   the wrap mask and element size are constants so every call inlines
+   and the compiler may unroll or vectorise the copies. Counts are in
+   elements. Free running counters, no transactions.
+
+   Like the default ringbuffer_t this is not thread safe. */
+
+#ifdef __cplusplus
+#define RINGBUF_STATIC_ASSERT(e, msg) static_assert(e, msg)
+#else
+#define RINGBUF_STATIC_ASSERT(e, msg) _Static_assert(e, msg)
+#endif
+
+#define RINGBUF_DEFINE(name, T, N) \
+RINGBUF_STATIC_ASSERT((N) > 0 && ((N) & ((N) - 1)) == 0, #name ": capacity must be a power of two"); \
+typedef struct name##_t_ { \
+    size_t wcount; \
+    size_t rcount; \
+    T      data[N]; \
+} name##_t; \
+static inline void name##_init(name##_t *rb) { \
+    rb->wcount = 0; \
+    rb->rcount = 0; \
+} \
+static inline size_t name##_read_avail(const name##_t *rb) { \
+    return rb->wcount - rb->rcount; \
+} \
+static inline size_t name##_write_avail(const name##_t *rb) { \
+    return (N) - (rb->wcount - rb->rcount); \
+} \
+static inline int name##_push(name##_t *rb, T v) { \
+    if( rb->wcount - rb->rcount == (N) ) return 0; \
+    rb->data[rb->wcount++ & ((N) - 1)] = v; \
+    return 1; \
+} \
+static inline int name##_pop(name##_t *rb, T *v) { \
+    if( rb->wcount == rb->rcount ) return 0; \
+    *v = rb->data[rb->rcount++ & ((N) - 1)]; \
+    return 1; \
+} \
+static inline T *name##_peek(name##_t *rb) { \
+    return rb->wcount == rb->rcount ? (T*)0 : &rb->data[rb->rcount & ((N) - 1)]; \
+} \
+static inline size_t name##_write(name##_t *rb, const T *src, size_t n) { \
+    size_t avail = name##_write_avail(rb); \
+    size_t pos = rb->wcount & ((N) - 1); \
+    size_t first = 0; \
+    if( n > avail ) n = avail; \
+    first = n < (N) - pos ? n : (N) - pos; \
+    memcpy(&rb->data[pos], src, first * sizeof(T)); \
+    memcpy(&rb->data[0], src + first, (n - first) * sizeof(T)); \
+    rb->wcount += n; \
+    return n; \
+} \
+static inline size_t name##_read(name##_t *rb, T *dst, size_t n) { \
+    size_t avail = name##_read_avail(rb); \
+    size_t pos = rb->rcount & ((N) - 1); \
+    size_t first = 0; \
+    if( n > avail ) n = avail; \
+    first = n < (N) - pos ? n : (N) - pos; \
+    memcpy(dst, &rb->data[pos], first * sizeof(T)); \
+    memcpy(dst + first, &rb->data[0], (n - first) * sizeof(T)); \
+    rb->rcount += n; \
+    return n; \
+}
+
+#endif
@@ -0,0 +1,137 @@
+
+#include "ringbuf_wait.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+
+static int ringbuffer_futex_wait(RINGBUF_ATOMIC(uint32_t) *addr, uint32_t val, const struct timespec *ts) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, ts, 0, 0);
+}
+
+static void ringbuffer_futex_wake(RINGBUF_ATOMIC(uint32_t) *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+}
+
+static uint64_t ringbuffer_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int ringbuffer_wait_init(ringbuffer_wait_t *w, ringbuffer_t *rb, int with_fd) {
+    w->rb = rb;
+    atomic_init(&w->rseq, 0);
+    atomic_init(&w->wseq, 0);
+    atomic_init(&w->rwaiters, 0);
+    atomic_init(&w->wwaiters, 0);
+    atomic_init(&w->fd_armed, 0);
+    atomic_init(&w->wakes, 0);
+    w->efd = -1;
+    if( with_fd ) {
+        w->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if( w->efd < 0 ) return -1;
+    }
+    return 0;
+}
+
+void ringbuffer_wait_destroy(ringbuffer_wait_t *w) {
+    if( w->efd >= 0 ) close(w->efd);
+    w->efd = -1;
+}
+
+/* announce in *waiters, re-check, then sleep on *seq */
+static int ringbuffer_wait_on(ringbuffer_wait_t *w, size_t size, int timeout_ms,
+                              size_t (*avail)(ringbuffer_t*),
+                              RINGBUF_ATOMIC(uint32_t) *seq, RINGBUF_ATOMIC(uint32_t) *waiters) {
+    uint64_t deadline = timeout_ms < 0 ? 0 : ringbuffer_now_ns() + (uint64_t)timeout_ms * 1000000ull;
+
+    for(;;) {
+        struct timespec ts, *tsp = 0;
+        uint32_t s = 0;
+
+        if( avail(w->rb) >= size ) return 0;
+
+        s = atomic_load(seq);
+        atomic_fetch_add(waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        if( avail(w->rb) >= size ) {
+            atomic_fetch_sub(waiters, 1);
+            return 0;
+        }
+
+        if( timeout_ms >= 0 ) {
+            uint64_t now = ringbuffer_now_ns();
+            uint64_t left = now < deadline ? deadline - now : 0;
+            if( !left ) {
+                atomic_fetch_sub(waiters, 1);
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            ts.tv_sec = (time_t)(left / 1000000000ull);
+            ts.tv_nsec = (long)(left % 1000000000ull);
+            tsp = &ts;
+        }
+
+        ringbuffer_futex_wait(seq, s, tsp);
+        atomic_fetch_sub(waiters, 1);
+    }
+}
+
+int ringbuffer_wait_readable(ringbuffer_wait_t *w, size_t size, int timeout_ms) {
+    return ringbuffer_wait_on(w, size, timeout_ms, ringbuffer_read_avail, &w->rseq, &w->rwaiters);
+}
+
+int ringbuffer_wait_writable(ringbuffer_wait_t *w, size_t size, int timeout_ms) {
+    return ringbuffer_wait_on(w, size, timeout_ms, ringbuffer_write_avail, &w->wseq, &w->wwaiters);
+}
+
+void ringbuffer_wait_notify_readable(ringbuffer_wait_t *w) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if( atomic_load_explicit(&w->rwaiters, memory_order_relaxed) ) {
+        atomic_fetch_add(&w->rseq, 1);
+        atomic_fetch_add_explicit(&w->wakes, 1, memory_order_relaxed);
+        ringbuffer_futex_wake(&w->rseq);
+    }
+    if( w->efd >= 0 && atomic_load_explicit(&w->fd_armed, memory_order_relaxed)
+        && atomic_exchange(&w->fd_armed, 0) ) {
+        uint64_t one = 1;
+        atomic_fetch_add_explicit(&w->wakes, 1, memory_order_relaxed);
+        if( write(w->efd, &one, sizeof(one)) < 0 ) {
+            /* counter overflow is the only failure, the fd is readable then */
+        }
+    }
+}
+
+void ringbuffer_wait_notify_writable(ringbuffer_wait_t *w) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if( atomic_load_explicit(&w->wwaiters, memory_order_relaxed) ) {
+        atomic_fetch_add(&w->wseq, 1);
+        atomic_fetch_add_explicit(&w->wakes, 1, memory_order_relaxed);
+        ringbuffer_futex_wake(&w->wseq);
+    }
+}
+
+int ringbuffer_wait_fd(ringbuffer_wait_t *w) {
+    return w->efd;
+}
+
+int ringbuffer_wait_fd_arm(ringbuffer_wait_t *w) {
+    uint64_t cnt = 0;
+    if( read(w->efd, &cnt, sizeof(cnt)) < 0 ) {
+        /* EAGAIN: nothing pending */
+    }
+    atomic_store(&w->fd_armed, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if( ringbuffer_read_avail(w->rb) ) {
+        atomic_store(&w->fd_armed, 0);
+        return 1;
+    }
+    return 0;
+}
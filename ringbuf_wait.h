@@ -0,0 +1,50 @@
+#ifndef __voidlizard_ringbuf_wait_h
+#define __voidlizard_ringbuf_wait_h
+
+#include "ringbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Blocking layer over a RINGBUF_MODE_SPSC buffer (Linux: futex, eventfd).
+
+   Waiters park on a futex after announcing themselves in r/wwaiters.
+   The other side calls ringbuffer_wait_notify_readable() after a commit
+   and ringbuffer_wait_notify_writable() after a read. A notify is a
+   fence and a load unless somebody is actually parked, so uncontended
+   write/read stay syscall free.
+
+   For epoll: add ringbuffer_wait_fd() (an eventfd) to the loop and call
+   ringbuffer_wait_fd_arm() before every epoll_wait(). It returns 1 if
+   data is already there and the loop must not sleep. The producer only
+   writes the eventfd while it is armed.
+
+   The wait functions return 0 when the requested amount is available,
+   -1 with errno == ETIMEDOUT on timeout. timeout_ms < 0 waits forever. */
+
+typedef struct ringbuffer_wait_t_ {
+    ringbuffer_t             *rb;
+    RINGBUF_ATOMIC(uint32_t) rseq;
+    RINGBUF_ATOMIC(uint32_t) wseq;
+    RINGBUF_ATOMIC(uint32_t) rwaiters;
+    RINGBUF_ATOMIC(uint32_t) wwaiters;
+    RINGBUF_ATOMIC(uint32_t) fd_armed;
+    RINGBUF_ATOMIC(uint32_t) wakes;     /* futex wakes + eventfd writes issued */
+    int                      efd;
+} ringbuffer_wait_t;
+
+int ringbuffer_wait_init(ringbuffer_wait_t *w, ringbuffer_t *rb, int with_fd);
+void ringbuffer_wait_destroy(ringbuffer_wait_t *w);
+int ringbuffer_wait_readable(ringbuffer_wait_t *w, size_t size, int timeout_ms);
+int ringbuffer_wait_writable(ringbuffer_wait_t *w, size_t size, int timeout_ms);
+void ringbuffer_wait_notify_readable(ringbuffer_wait_t *w);
+void ringbuffer_wait_notify_writable(ringbuffer_wait_t *w);
+int ringbuffer_wait_fd(ringbuffer_wait_t *w);
+int ringbuffer_wait_fd_arm(ringbuffer_wait_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,10 +3,27 @@
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
 
 #include "fsm.h"
 
 #include "ringbuf.h"
+#include "ringbuf_mirror.h"
+#include "ringbuf_fd.h"
+#include "ringbuf_msg.h"
+#include "ringbuf_mpsc.h"
+#include "ringbuf_wait.h"
+#include "ringbuf_shm.h"
+#include "ringbuf_static.h"
+#include "ringbuf_bcast.h"
+#include "ringbuf_spill.h"
 
 void test_validate_rb(ringbuffer_t *rb) {
     uint8_t *rp = rb->rp;
@@ -57,7 +74,7 @@ void test_dump(uint8_t *from, uint8_t *to, char *fmt) {
 
 int test_case_1() {
     ringbuffer_t *rb;
-    static uint8_t databuf[(sizeof(ringbuffer_t) - 1 + 256)];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(256)];
     printf("TEST CASE #1 :: NAME = Buffer init\n");
     rb = ringbuffer_alloc(sizeof(databuf), databuf);
     printf("TEST CASE #1 :: LOG = %d %d %d\n", rb->data_size, ringbuffer_read_avail(rb), ringbuffer_write_avail(rb));
@@ -71,7 +88,7 @@ int test_case_1() {
 
 int test_case_2() {
     ringbuffer_t *rb;
-    static uint8_t databuf[(sizeof(ringbuffer_t) - 1 + 256)];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(256)];
     uint8_t pattern[6] = { 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF };
     uint8_t written = 0, ra = 0, wa = 0;
     printf("TEST CASE #2 :: NAME = Simple write \n");
@@ -90,7 +107,7 @@ int test_case_2() {
 
 int test_case_3() {
     ringbuffer_t *rb;
-    static uint8_t databuf[(sizeof(ringbuffer_t) - 1 + 64)];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
     uint8_t pattern[6] = { '0', '1', '2', '3', '4', '5' };
     uint8_t result[64 + 1] = { 0 };
     int i = 0;
@@ -120,7 +137,7 @@ int test_case_3() {
 
 int test_case_4() {
     ringbuffer_t *rb;
-    static uint8_t databuf[(sizeof(ringbuffer_t) - 1 + 64)];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
     static const uint8_t pattern[] = { '*', '@' };
     static uint8_t result[64 + 1] = { 0 };
     static const char expected[65] = "DEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmno0123456789*@*@*@*@*@";
@@ -191,7 +208,7 @@ int test_case_4() {
 
 int test_case_5() {
     ringbuffer_t *rb;
-    static uint8_t databuf[(sizeof(ringbuffer_t) - 1 + 64)];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
     static uint8_t pattern[32] = { 0 };
     static uint8_t result[64 + 1] = { 0 };
     static const char expected[65] = "DEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmno0123456789++++++++++";
@@ -264,7 +281,7 @@ int test_case_5() {
 
 int test_case_6() {
     ringbuffer_t *rb;
-    static uint8_t databuf[(sizeof(ringbuffer_t) - 1 + 64)];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
     static const uint8_t pattern[] = { '+', '-' };
     static uint8_t result[64 + 1] = {0};
     static const char expected[65] = ";<=>?@ABCDEFGH+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-";
@@ -673,6 +690,1644 @@ int test_case_10() {
 }
 
 
+#define TEST_CASE_11_LEN    (1024*1024)
+#define TEST_CASE_11_CHUNK  64
+#define TEST_CASE_11_JUNK   0xEE
+
+static void *test_case_11_producer(void *arg) {
+    ringbuffer_t *rb = (ringbuffer_t*)arg;
+    uint8_t chunk[TEST_CASE_11_CHUNK];
+    size_t written = 0;
+    unsigned seed = 11;
+
+    ringbuffer_update_flags(rb, 0, RINGBUF_AUTOCOMMIT);
+
+    while( written < TEST_CASE_11_LEN ) {
+        size_t len = 1 + ((size_t)rand_r(&seed)) % TEST_CASE_11_CHUNK;
+        size_t i = 0;
+        len = written + len <= TEST_CASE_11_LEN ? len : TEST_CASE_11_LEN - written;
+
+        if( ringbuffer_write_avail(rb) < len ) {
+            sched_yield();
+            continue;
+        }
+
+        /* every few frames write junk and throw it away */
+        if( !(rand_r(&seed) % 7) ) {
+            memset(chunk, TEST_CASE_11_JUNK, len);
+            ringbuffer_write(rb, chunk, len);
+            ringbuffer_rollback(rb);
+        }
+
+        for(i = 0; i < len; i++) {
+            chunk[i] = (uint8_t)((written + i) % 251);
+        }
+        ringbuffer_write(rb, chunk, len);
+        ringbuffer_commit(rb);
+        written += len;
+    }
+    return 0;
+}
+
+int test_case_11() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(100)];
+    uint8_t chunk[TEST_CASE_11_CHUNK];
+    size_t read = 0, bad = 0;
+    pthread_t producer;
+
+    printf("TEST CASE #11 :: NAME = SPSC_THREADS\n");
+
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC);
+    pthread_create(&producer, 0, test_case_11_producer, rb);
+
+    while( read < TEST_CASE_11_LEN ) {
+        size_t n = ringbuffer_read(rb, chunk, sizeof(chunk));
+        size_t i = 0;
+        if( !n ) {
+            sched_yield();
+            continue;
+        }
+        for(i = 0; i < n; i++) {
+            bad += chunk[i] != (uint8_t)((read + i) % 251);
+        }
+        read += n;
+    }
+
+    pthread_join(producer, 0);
+
+    printf("TEST CASE #11 :: LOG = read: %d, bad: %d, ra: %d, wa: %d\n",
+           read, bad, ringbuffer_read_avail(rb), ringbuffer_write_avail(rb));
+
+    if( !bad && read == TEST_CASE_11_LEN
+        && ringbuffer_read_avail(rb) == 0
+        && ringbuffer_write_avail(rb) == rb->data_size ) {
+        printf("TEST CASE #11 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #11 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_12() {
+    ringbuffer_t *rb;
+    uint8_t databuf[RINGBUF_ALLOC_SIZE(16)] = { 0 };
+    uint8_t tmp[16] = { 0 };
+    uint8_t result[16 + 1] = { 0 };
+    ringbuffer_span_t ws[2], rs[2];
+    size_t reserved = 0, peeked = 0, i = 0, n = 0;
+
+    printf("TEST CASE #12 :: NAME = ZERO_COPY_RESERVE_PEEK\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+
+    ringbuffer_write(rb, tmp, 10);
+    ringbuffer_read(rb, tmp, 10);
+
+    reserved = ringbuffer_write_reserve(rb, 12, ws);
+    for(i = 0; i < ws[0].len; i++) ws[0].ptr[i] = 'a' + n++;
+    for(i = 0; i < ws[1].len; i++) ws[1].ptr[i] = 'a' + n++;
+    ringbuffer_write_advance(rb, reserved);
+
+    printf("TEST CASE #12 :: LOG = reserved: %d (%d + %d)\n", reserved, ws[0].len, ws[1].len);
+
+    peeked = ringbuffer_read_peek(rb, 64, rs);
+    printf("TEST CASE #12 :: LOG = peeked: %d (%d + %d)\n", peeked, rs[0].len, rs[1].len);
+
+    memcpy(result, rs[0].ptr, rs[0].len);
+    memcpy(result + rs[0].len, rs[1].ptr, rs[1].len);
+    printf("TEST CASE #12 :: LOG = %s\n", result);
+
+    ringbuffer_read_consume(rb, 4);
+
+    if( reserved == 12 && ws[0].len == 6 && ws[1].len == 6 && ws[1].ptr == rb->bs
+        && peeked == 12 && rs[0].ptr == ws[0].ptr && rs[1].len == 6
+        && !strncmp(result, "abcdefghijkl", 12)
+        && ringbuffer_read_avail(rb) == 8
+        && ringbuffer_write_avail(rb) == 8
+        && rb->rp == rb->bs + 14 ) {
+        printf("TEST CASE #12 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #12 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_13() {
+    ringbuffer_t *rb;
+    static uint8_t chunk[3000];
+    static uint8_t result[3000];
+    ringbuffer_span_t ws[2], rs[2];
+    size_t reserved = 0, peeked = 0, read = 0, i = 0;
+    int res = 0;
+
+    printf("TEST CASE #13 :: NAME = MIRROR_CONTIGUOUS\n");
+
+    rb = ringbuffer_alloc_mirror(4000, 0);
+    if( !rb ) {
+        printf("TEST CASE #13 :: RESULT = FAIL\n");
+        return (-1);
+    }
+
+    for(i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)(i % 253);
+
+    ringbuffer_write(rb, chunk, sizeof(chunk));
+    ringbuffer_read(rb, result, sizeof(result));
+
+    /* this one crosses be */
+    reserved = ringbuffer_write_reserve(rb, 2000, ws);
+    memcpy(ws[0].ptr, chunk, ws[0].len);
+    ringbuffer_write_advance(rb, reserved);
+
+    peeked = ringbuffer_read_peek(rb, 2000, rs);
+    read = ringbuffer_read(rb, result, sizeof(result));
+
+    printf("TEST CASE #13 :: LOG = data_size: %d, reserved: %d (%d + %d), peeked: %d (%d + %d), read: %d\n",
+           rb->data_size, reserved, ws[0].len, ws[1].len, peeked, rs[0].len, rs[1].len, read);
+
+    res = rb->data_size == 4096
+       && reserved == 2000 && ws[1].len == 0
+       && peeked == 2000 && rs[1].len == 0
+       && rs[0].ptr + rs[0].len > rb->be
+       && read == 2000 && !memcmp(result, chunk, 2000)
+       && rb->bs[0] == chunk[rb->be - ws[0].ptr]
+       && rb->rp == rb->bs + 904
+       && !ringbuffer_alloc_mirror(4000, RINGBUF_MODE_SHM)
+       && !ringbuffer_alloc_mirror(4000, RINGBUF_MODE_HEAP);
+
+    ringbuffer_free_mirror(rb);
+
+    if( res ) {
+        printf("TEST CASE #13 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #13 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_14() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(1024)];
+    static uint8_t chunk[1024];
+    static uint8_t result[1024];
+    static uint8_t expected[1024];
+    ringbuffer_savepoint_t sp1, sp2;
+    size_t ra0 = 0, wa0 = 0, ra1 = 0, wa1 = 0, wa2 = 0, ra2 = 0, read = 0;
+    size_t full = 0, i = 0;
+    int res = 1;
+
+    printf("TEST CASE #14 :: NAME = TRANSACTION_WIDE_SAVEPOINTS\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+    ringbuffer_update_flags(rb, 0, RINGBUF_AUTOCOMMIT);
+
+    for(i = 0; i < sizeof(chunk); i++) chunk[i] = (uint8_t)(i % 251);
+
+    /* move rp/wp close to be */
+    ringbuffer_write(rb, chunk, 700);
+    ringbuffer_commit(rb);
+    ringbuffer_read(rb, result, 700);
+
+    /* 1000 uncommitted bytes across the wrap point */
+    ringbuffer_write(rb, chunk, 1000);
+    ra0 = ringbuffer_read_avail(rb);
+    wa0 = ringbuffer_write_avail(rb);
+    ringbuffer_commit(rb);
+    ra1 = ringbuffer_read_avail(rb);
+    wa1 = ringbuffer_write_avail(rb);
+    read = ringbuffer_read(rb, result, sizeof(result));
+    res = res && read == 1000 && !memcmp(result, chunk, 1000);
+
+    printf("TEST CASE #14 :: LOG = ra0: %d, wa0: %d, ra1: %d, wa1: %d, read: %d\n", ra0, wa0, ra1, wa1, read);
+    res = res && ra0 == 0 && wa0 == 24 && ra1 == 1000 && wa1 == 24;
+
+    /* fill the whole buffer in one transaction and roll it back */
+    full = ringbuffer_write(rb, chunk, sizeof(chunk));
+    wa2 = ringbuffer_write_avail(rb);
+    ringbuffer_rollback(rb);
+    ra2 = ringbuffer_read_avail(rb);
+    printf("TEST CASE #14 :: LOG = full: %d, wa2: %d, ra2: %d, wa: %d\n", full, wa2, ra2, ringbuffer_write_avail(rb));
+    res = res && full == 1024 && wa2 == 0 && ra2 == 0 && ringbuffer_write_avail(rb) == 1024;
+
+    /* A sp1 B sp2 C -> rollback_to(sp2) D -> rollback_to(sp1) E -> A E */
+    memset(expected, 'A', 300);
+    memset(expected + 300, 'E', 400);
+    memset(chunk, 'A', 300); ringbuffer_write(rb, chunk, 300);
+    ringbuffer_savepoint(rb, &sp1);
+    memset(chunk, 'B', 300); ringbuffer_write(rb, chunk, 300);
+    ringbuffer_savepoint(rb, &sp2);
+    memset(chunk, 'C', 300); ringbuffer_write(rb, chunk, 300);
+    ringbuffer_rollback_to(rb, &sp2);
+    memset(chunk, 'D', 300); ringbuffer_write(rb, chunk, 300);
+    ringbuffer_rollback_to(rb, &sp1);
+    memset(chunk, 'E', 400); ringbuffer_write(rb, chunk, 400);
+    ringbuffer_commit(rb);
+    ringbuffer_rollback_to(rb, &sp2);
+
+    read = ringbuffer_read(rb, result, sizeof(result));
+    printf("TEST CASE #14 :: LOG = savepoints read: %d\n", read);
+    res = res && read == 700 && !memcmp(result, expected, 700);
+
+    /* a stale savepoint smaller than the current transaction: ignored */
+    memset(chunk, 'F', 100); ringbuffer_write(rb, chunk, 100);
+    ringbuffer_savepoint(rb, &sp1);
+    ringbuffer_commit(rb);
+    memset(chunk, 'G', 300); ringbuffer_write(rb, chunk, 300);
+    ringbuffer_rollback_to(rb, &sp1);
+    ringbuffer_rollback(rb);
+    memset(chunk, 'H', 300); ringbuffer_write(rb, chunk, 300);
+    ringbuffer_rollback_to(rb, &sp1);
+    ringbuffer_commit(rb);
+    read = ringbuffer_read(rb, result, sizeof(result));
+    printf("TEST CASE #14 :: LOG = stale savepoint read: %d\n", read);
+    res = res && read == 400 && result[0] == 'F' && result[100] == 'H' && result[399] == 'H';
+
+    if( res ) {
+        printf("TEST CASE #14 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #14 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_15() {
+    ringbuffer_t *rb;
+    uint8_t databuf[RINGBUF_ALLOC_SIZE(20)] = { 0 };
+    uint8_t hdr[] = "HDR:", payload[] = "payload", trailer[] = ";\n";
+    uint8_t r1[8] = { 0 }, r2[32] = { 0 };
+    uint8_t tmp[32] = { 0 };
+    ringbuffer_span_t wv[3], rv[2];
+    size_t w1 = 0, w2 = 0, read = 0;
+
+    printf("TEST CASE #15 :: NAME = WRITEV_READV\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+
+    /* put wp close to be so the message wraps */
+    ringbuffer_write(rb, tmp, 15);
+    ringbuffer_read(rb, tmp, 15);
+
+    wv[0].ptr = hdr;     wv[0].len = 4;
+    wv[1].ptr = payload; wv[1].len = 7;
+    wv[2].ptr = trailer; wv[2].len = 2;
+    w1 = ringbuffer_writev(rb, wv, 3);
+    w2 = ringbuffer_writev(rb, wv, 3);   /* 13 + 13 > 20, must not write */
+
+    rv[0].ptr = r1; rv[0].len = 4;
+    rv[1].ptr = r2; rv[1].len = sizeof(r2);
+    read = ringbuffer_readv(rb, rv, 2);
+
+    printf("TEST CASE #15 :: LOG = w1: %d, w2: %d, read: %d, %.4s|%s\n", w1, w2, read, r1, r2);
+
+    if( w1 == 13 && w2 == 0 && read == 13
+        && !memcmp(r1, "HDR:", 4) && !strcmp(r2, "payload;\n")
+        && ringbuffer_read_avail(rb) == 0 ) {
+        printf("TEST CASE #15 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #15 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_CASE_16_LEN    (100*1000)
+#define TEST_CASE_16_CHUNK  97
+
+int test_case_16() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
+    static uint8_t src[TEST_CASE_16_LEN];
+    static uint8_t dst[TEST_CASE_16_LEN];
+    int sv[2] = { -1, -1 }, pp[2] = { -1, -1 };
+    size_t sent = 0, received = 0, i = 0;
+    ssize_t full = 0;
+    int full_errno = 0, eof = 0;
+    unsigned seed = 16;
+
+    printf("TEST CASE #16 :: NAME = FD_FILL_DRAIN\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+
+    if( socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0 || pipe(pp) < 0 ) {
+        printf("TEST CASE #16 :: RESULT = FAIL\n");
+        return (-1);
+    }
+
+    fcntl(sv[1], F_SETFL, O_NONBLOCK);
+    fcntl(pp[0], F_SETFL, O_NONBLOCK);
+
+    for(i = 0; i < sizeof(src); i++) src[i] = (uint8_t)rand_r(&seed);
+
+    /* socket -> ring -> pipe, small random steps so the ring wraps a lot */
+    while( received < TEST_CASE_16_LEN ) {
+        size_t len = 1 + ((size_t)rand_r(&seed)) % TEST_CASE_16_CHUNK;
+        ssize_t n = 0;
+        len = sent + len <= TEST_CASE_16_LEN ? len : TEST_CASE_16_LEN - sent;
+        if( len ) {
+            sent += (size_t)write(sv[0], src + sent, len);
+        }
+        if( sent == TEST_CASE_16_LEN && !eof ) {
+            shutdown(sv[0], SHUT_WR);
+            eof = 1;
+        }
+        n = ringbuffer_fill_from_fd(rb, sv[1]);
+        if( n < 0 && errno == ENOBUFS ) {
+            full = n;
+            full_errno = errno;
+        }
+        if( rand_r(&seed) % 3 || eof ) {
+            ringbuffer_drain_to_fd(rb, pp[1]);
+        }
+        n = read(pp[0], dst + received, TEST_CASE_16_LEN - received);
+        if( n > 0 ) received += (size_t)n;
+    }
+
+    eof = (int)ringbuffer_fill_from_fd(rb, sv[1]);
+    printf("TEST CASE #16 :: LOG = sent: %d, received: %d, full: %d, eof: %d\n",
+           sent, received, full, eof);
+
+    close(sv[0]); close(sv[1]);
+    close(pp[0]); close(pp[1]);
+
+    if( received == TEST_CASE_16_LEN && !memcmp(src, dst, TEST_CASE_16_LEN)
+        && full == -1 && full_errno == ENOBUFS && eof == 0 ) {
+        printf("TEST CASE #16 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #16 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_CASE_17_LEN    (64*1024)
+
+int test_case_17() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(100)];
+    static uint8_t r1[TEST_CASE_17_LEN];
+    static uint8_t r2[TEST_CASE_17_LEN];
+    uint8_t chunk[48];
+    size_t written = 0, read = 0, wa0 = 0;
+    unsigned seed = 17;
+    int res = 1;
+
+    printf("TEST CASE #17 :: NAME = POW2_COUNTERS\n");
+
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_POW2);
+    wa0 = ringbuffer_write_avail(rb);
+    ringbuffer_update_flags(rb, 0, RINGBUF_AUTOCOMMIT);
+
+    while( read < TEST_CASE_17_LEN ) {
+        size_t wlen = ((size_t)rand_r(&seed)) % sizeof(chunk);
+        size_t rlen = ((size_t)rand_r(&seed)) % sizeof(chunk);
+        size_t ra = ringbuffer_read_avail(rb);
+        size_t wa = ringbuffer_write_avail(rb);
+
+        wlen = written + wlen <= TEST_CASE_17_LEN ? wlen : TEST_CASE_17_LEN - written;
+        res = res && ra + wa == rb->data_size;
+
+        if( wlen && wlen <= wa ) {
+            memset(chunk, 'a' + (written % 26), wlen);
+            if( rand_r(&seed) % 4 ) {
+                memcpy(r1 + written, chunk, wlen);
+                ringbuffer_write(rb, chunk, wlen);
+                ringbuffer_commit(rb);
+                written += wlen;
+            } else {
+                ringbuffer_write(rb, chunk, wlen);
+                ringbuffer_rollback(rb);
+            }
+        }
+        read += ringbuffer_read(rb, r2 + read, rlen);
+    }
+
+    printf("TEST CASE #17 :: LOG = data_size: %d, wa0: %d, written: %d, read: %d, wcount: %d\n",
+           rb->data_size, wa0, written, read, (size_t)rb->wcount);
+
+    if( res && rb->data_size == 64 && wa0 == 64
+        && read == TEST_CASE_17_LEN && !memcmp(r1, r2, TEST_CASE_17_LEN)
+        && rb->wcount == TEST_CASE_17_LEN && rb->rcount == TEST_CASE_17_LEN ) {
+        printf("TEST CASE #17 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #17 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_18() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(300)];
+    static uint8_t big[200];
+    uint8_t result[256] = { 0 };
+    uint8_t tmp[300] = { 0 };
+    size_t w1 = 0, w2 = 0, w3 = 0, w4 = 0, l1 = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0;
+    int res = 1;
+
+    printf("TEST CASE #18 :: NAME = MSG_FRAMING\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+    memset(big, 'B', sizeof(big));
+
+    /* leave one byte before be: the next header must not be split */
+    ringbuffer_write(rb, tmp, 299);
+    ringbuffer_read(rb, tmp, 299);
+
+    w1 = ringbuffer_msg_write(rb, big, sizeof(big));      /* 2 byte header */
+    res = res && rb->bs[299] == 0 && rb->bs[0] == (0x80 | (200 & 0x7F)) && rb->bs[1] == 1;
+
+    w2 = ringbuffer_msg_write(rb, "hello", 5);
+    w3 = ringbuffer_msg_write(rb, big, 100);              /* does not fit */
+
+    /* uncommitted record goes away with the transaction */
+    ringbuffer_update_flags(rb, 0, RINGBUF_AUTOCOMMIT);
+    w4 = ringbuffer_msg_write(rb, "junk", 4);
+    ringbuffer_rollback(rb);
+    ringbuffer_update_flags(rb, 1, RINGBUF_AUTOCOMMIT);
+
+    l1 = ringbuffer_msg_peek_len(rb);
+    r1 = ringbuffer_msg_read(rb, result, 10);              /* too small */
+    r2 = ringbuffer_msg_read(rb, result, sizeof(result));
+    res = res && !memcmp(result, big, sizeof(big));
+    memset(result, 0, sizeof(result));
+    r3 = ringbuffer_msg_read(rb, result, sizeof(result));
+    res = res && !strcmp(result, "hello");
+    r4 = ringbuffer_msg_read(rb, result, sizeof(result));
+
+    printf("TEST CASE #18 :: LOG = w: %d %d %d %d, peek: %d, r: %d %d %d %d\n",
+           w1, w2, w3, w4, l1, r1, r2, r3, r4);
+
+    if( res && w1 == 200 && w2 == 5 && w3 == 0 && w4 == 4
+        && l1 == 200 && r1 == 0 && r2 == 200 && r3 == 5 && r4 == 0
+        && ringbuffer_read_avail(rb) == 0 ) {
+        printf("TEST CASE #18 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #18 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_CASE_19_PRODUCERS  4
+#define TEST_CASE_19_RECORDS    20000
+
+typedef struct test_case_19_arg_t_ {
+    ringbuffer_t *rb;
+    uint8_t      id;
+} test_case_19_arg_t;
+
+/* record: producer id, 32 bit sequence, then (seq % 23) filler bytes */
+static void *test_case_19_producer(void *arg) {
+    test_case_19_arg_t *a = (test_case_19_arg_t*)arg;
+    uint8_t rec[5 + 23];
+    uint32_t seq = 0;
+    while( seq < TEST_CASE_19_RECORDS ) {
+        size_t len = 5 + seq % 23;
+        rec[0] = a->id;
+        memcpy(rec + 1, &seq, sizeof(seq));
+        memset(rec + 5, a->id ^ (uint8_t)seq, len - 5);
+        if( ringbuffer_mpsc_write(a->rb, rec, len) ) {
+            seq++;
+        } else {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+int test_case_19() {
+    ringbuffer_t *rb;
+    static uint64_t databuf[RINGBUF_ALLOC_SIZE(1024) / sizeof(uint64_t) + 1];
+    test_case_19_arg_t args[TEST_CASE_19_PRODUCERS];
+    pthread_t producers[TEST_CASE_19_PRODUCERS];
+    uint32_t next[TEST_CASE_19_PRODUCERS] = { 0 };
+    ringbuffer_mpsc_slot_t s1, s2;
+    uint8_t rec[64];
+    size_t total = 0, bad = 0, l0 = 0, l1 = 0, r1 = 0, r2 = 0, i = 0;
+
+    printf("TEST CASE #19 :: NAME = MPSC_THREADS\n");
+
+#ifndef RINGBUF_CACHELINE
+    /* a misaligned array is refused, the cacheline build realigns it */
+    bad += ringbuffer_alloc_mode(sizeof(databuf) - 1, (uint8_t*)databuf + 1, RINGBUF_MODE_MPSC) != 0;
+#endif
+    rb = ringbuffer_alloc_mode(sizeof(databuf), (uint8_t*)databuf, RINGBUF_MODE_MPSC);
+    bad += (uintptr_t)rb->bs % 4 != 0;
+
+    /* out of order publication: B is invisible until A is published */
+    ringbuffer_mpsc_reserve(rb, 3, &s1);
+    ringbuffer_mpsc_reserve(rb, 3, &s2);
+    memcpy(s1.span[0].ptr, "AAA", 3);
+    memcpy(s2.span[0].ptr, "BBB", 3);
+    ringbuffer_mpsc_publish(rb, &s2);
+    l0 = ringbuffer_mpsc_peek_len(rb);
+    ringbuffer_mpsc_publish(rb, &s1);
+    l1 = ringbuffer_mpsc_peek_len(rb);
+    r1 = ringbuffer_mpsc_read(rb, rec, sizeof(rec));
+    bad += memcmp(rec, "AAA", 3) != 0;
+    r2 = ringbuffer_mpsc_read(rb, rec, sizeof(rec));
+    bad += memcmp(rec, "BBB", 3) != 0;
+
+    printf("TEST CASE #19 :: LOG = data_size: %d, l0: %d, l1: %d, r1: %d, r2: %d\n",
+           rb->data_size, l0, l1, r1, r2);
+
+    for(i = 0; i < TEST_CASE_19_PRODUCERS; i++) {
+        args[i].rb = rb;
+        args[i].id = (uint8_t)i;
+        pthread_create(&producers[i], 0, test_case_19_producer, &args[i]);
+    }
+
+    while( total < TEST_CASE_19_PRODUCERS * TEST_CASE_19_RECORDS ) {
+        size_t len = ringbuffer_mpsc_read(rb, rec, sizeof(rec));
+        uint32_t seq = 0;
+        uint8_t id = 0;
+        if( !len ) {
+            sched_yield();
+            continue;
+        }
+        id = rec[0];
+        memcpy(&seq, rec + 1, sizeof(seq));
+        bad += id >= TEST_CASE_19_PRODUCERS || seq != next[id] || len != 5 + seq % 23;
+        for(i = 5; i < len; i++) bad += rec[i] != (uint8_t)(id ^ (uint8_t)seq);
+        if( id < TEST_CASE_19_PRODUCERS ) next[id] = seq + 1;
+        total++;
+    }
+
+    for(i = 0; i < TEST_CASE_19_PRODUCERS; i++) {
+        pthread_join(producers[i], 0);
+    }
+
+    printf("TEST CASE #19 :: LOG = records: %d, bad: %d\n", total, bad);
+
+    if( !bad && l0 == 0 && l1 == 3 && r1 == 3 && r2 == 3
+        && ringbuffer_mpsc_peek_len(rb) == 0
+        && rb->wcount == rb->rcount ) {
+        printf("TEST CASE #19 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #19 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_20() {
+    ringbuffer_t *rb;
+    uint8_t databuf[RINGBUF_ALLOC_SIZE(16)] = { 0 };
+    uint8_t msgbuf[RINGBUF_ALLOC_SIZE(32)] = { 0 };
+    const uint8_t data[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    uint8_t result[64] = { 0 };
+    uint8_t rec[10];
+    size_t w1 = 0, w2 = 0, o1 = 0, o2 = 0, read = 0, i = 0, nrec = 0, om = 0;
+    int res = 1;
+
+    printf("TEST CASE #20 :: NAME = OVERWRITE_OLDEST\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+    ringbuffer_update_flags(rb, 1, RINGBUF_OVERWRITE);
+
+    ringbuffer_write(rb, data, 10);
+    w1 = ringbuffer_write(rb, data + 10, 10);          /* drops 4 oldest */
+    o1 = ringbuffer_overrun(rb);
+    read = ringbuffer_read(rb, result, sizeof(result));
+    res = res && read == 16 && !memcmp(result, data + 4, 16);
+
+    w2 = ringbuffer_write(rb, data, 36);               /* keeps the last 16 */
+    o2 = ringbuffer_overrun(rb);
+    read = ringbuffer_read(rb, result, sizeof(result));
+    res = res && read == 16 && !memcmp(result, data + 20, 16);
+
+    printf("TEST CASE #20 :: LOG = w1: %d, o1: %d, w2: %d, o2: %d\n", w1, o1, w2, o2);
+    res = res && w1 == 10 && o1 == 4 && w2 == 36 && o2 == 24;
+
+    /* framed: whole records go, 11 bytes each (1 byte header) */
+    rb = ringbuffer_alloc(sizeof(msgbuf), msgbuf);
+    ringbuffer_update_flags(rb, 1, RINGBUF_OVERWRITE);
+    for(i = 0; i < 5; i++) {
+        memset(rec, '0' + i, sizeof(rec));
+        res = res && ringbuffer_msg_write(rb, rec, sizeof(rec)) == sizeof(rec);
+    }
+    om = ringbuffer_overrun(rb);
+    while( ringbuffer_msg_read(rb, result, sizeof(result)) == sizeof(rec) ) {
+        res = res && result[0] == '0' + 3 + nrec && result[9] == result[0];
+        nrec++;
+    }
+
+    printf("TEST CASE #20 :: LOG = records: %d, overrun: %d\n", nrec, om);
+
+    if( res && nrec == 2 && om == 33 ) {
+        printf("TEST CASE #20 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #20 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_CASE_21_LEN    (256*1024)
+
+static void *test_case_21_producer(void *arg) {
+    ringbuffer_wait_t *w = (ringbuffer_wait_t*)arg;
+    uint8_t chunk[100];
+    size_t written = 0, i = 0;
+    while( written < TEST_CASE_21_LEN ) {
+        size_t len = sizeof(chunk) < TEST_CASE_21_LEN - written ? sizeof(chunk) : TEST_CASE_21_LEN - written;
+        if( ringbuffer_wait_writable(w, len, -1) ) break;
+        for(i = 0; i < len; i++) chunk[i] = (uint8_t)((written + i) % 249);
+        ringbuffer_write(w->rb, chunk, len);
+        ringbuffer_wait_notify_readable(w);
+        written += len;
+    }
+    return 0;
+}
+
+static void *test_case_21_late_writer(void *arg) {
+    ringbuffer_wait_t *w = (ringbuffer_wait_t*)arg;
+    usleep(20000);
+    ringbuffer_write(w->rb, "x", 1);
+    ringbuffer_wait_notify_readable(w);
+    return 0;
+}
+
+int test_case_21() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(1000)];
+    ringbuffer_wait_t w;
+    pthread_t producer;
+    struct epoll_event ev, out;
+    uint8_t chunk[128];
+    size_t read = 0, bad = 0, i = 0;
+    int timeout_rc = 0, timeout_errno = 0, armed = 0, nev = 0, ep = -1;
+    uint32_t wakes0 = 0;
+    int res = 1;
+
+    printf("TEST CASE #21 :: NAME = WAIT_FUTEX_EVENTFD\n");
+
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC);
+    ringbuffer_wait_init(&w, rb, 1);
+
+    /* timeout on an empty ring */
+    timeout_rc = ringbuffer_wait_readable(&w, 1, 30);
+    timeout_errno = errno;
+    res = res && timeout_rc == -1 && timeout_errno == ETIMEDOUT;
+
+    /* nobody waits: notify must not issue any syscall */
+    ringbuffer_wait_notify_readable(&w);
+    ringbuffer_wait_notify_writable(&w);
+    wakes0 = w.wakes;
+    res = res && wakes0 == 0;
+
+    /* blocking producer/consumer */
+    pthread_create(&producer, 0, test_case_21_producer, &w);
+    while( read < TEST_CASE_21_LEN ) {
+        size_t n = 0;
+        if( ringbuffer_wait_readable(&w, 1, 1000) ) break;
+        n = ringbuffer_read(rb, chunk, sizeof(chunk));
+        ringbuffer_wait_notify_writable(&w);
+        for(i = 0; i < n; i++) bad += chunk[i] != (uint8_t)((read + i) % 249);
+        read += n;
+    }
+    pthread_join(producer, 0);
+    res = res && read == TEST_CASE_21_LEN && !bad;
+
+    /* epoll on the eventfd */
+    ep = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.fd = ringbuffer_wait_fd(&w);
+    epoll_ctl(ep, EPOLL_CTL_ADD, ringbuffer_wait_fd(&w), &ev);
+    armed = ringbuffer_wait_fd_arm(&w);
+    pthread_create(&producer, 0, test_case_21_late_writer, &w);
+    nev = epoll_wait(ep, &out, 1, 1000);
+    pthread_join(producer, 0);
+    close(ep);
+    res = res && armed == 0 && nev == 1 && ringbuffer_read_avail(rb) == 1;
+    res = res && ringbuffer_wait_fd_arm(&w) == 1;
+
+    printf("TEST CASE #21 :: LOG = timeout: %d/%d, read: %d, bad: %d, wakes: %d, epoll: %d\n",
+           timeout_rc, timeout_errno == ETIMEDOUT, read, bad, w.wakes, nev);
+
+    ringbuffer_wait_destroy(&w);
+
+    if( res ) {
+        printf("TEST CASE #21 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #21 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_22() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
+    uint8_t rec[8] = { 0 };
+    size_t i = 0, n = 0, ra0 = 0, ra1 = 0, rc0 = 0, rc1 = 0, rc2 = 0, wa0 = 0, wa1 = 0;
+    int res = 1;
+
+    printf("TEST CASE #22 :: NAME = BATCH_PUBLISH\n");
+
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2);
+
+    /* producer batch: nothing visible until the end */
+    ringbuffer_write_batch_begin(rb);
+    for(i = 0; i < 5; i++) {
+        memset(rec, 'a' + i, sizeof(rec));
+        ringbuffer_msg_write(rb, rec, sizeof(rec));
+    }
+    ra0 = ringbuffer_read_avail(rb);
+    ringbuffer_write_batch_end(rb);
+    ra1 = ringbuffer_read_avail(rb);
+    res = res && (rb->flags & RINGBUF_AUTOCOMMIT);
+
+    /* consumer batch: rcount moves once */
+    rc0 = rb->rcount;
+    ringbuffer_read_batch_begin(rb);
+    while( ringbuffer_msg_read(rb, rec, sizeof(rec)) == sizeof(rec) ) {
+        res = res && rec[0] == 'a' + n && rec[7] == rec[0];
+        n++;
+    }
+    rc1 = rb->rcount;
+    wa0 = ringbuffer_write_avail(rb);
+    ringbuffer_read_batch_end(rb);
+    rc2 = rb->rcount;
+    wa1 = ringbuffer_write_avail(rb);
+
+    printf("TEST CASE #22 :: LOG = ra0: %d, ra1: %d, n: %d, rcount: %d %d %d, wa0: %d, wa1: %d\n",
+           ra0, ra1, n, rc0, rc1, rc2, wa0, wa1);
+
+    if( res && ra0 == 0 && ra1 == 45 && n == 5
+        && rc0 == 0 && rc1 == 0 && rc2 == 45
+        && wa0 == 64 - 45 && wa1 == 64 && ringbuffer_read_avail(rb) == 0 ) {
+        printf("TEST CASE #22 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #22 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_SHM_BYTES 100000
+
+/* shm consumer in a child process: checks the byte pattern and exits */
+static void test_case_23_child(int fd, int crash) {
+    ringbuffer_shm_t s;
+    uint8_t buf[37];
+    size_t got = 0, i = 0, n = 0;
+    if( ringbuffer_shm_attach_fd(&s, fd, RINGBUF_SHM_CONSUMER) < 0 ) _exit(2);
+    if( crash ) _exit(0);
+    while( got < TEST_SHM_BYTES ) {
+        n = ringbuffer_read(s.rb, buf, sizeof(buf));
+        if( !n ) { sched_yield(); continue; }
+        for(i = 0; i < n; i++) {
+            if( buf[i] != (uint8_t)((got + i) % 251) ) _exit(1);
+        }
+        got += n;
+    }
+    ringbuffer_shm_detach(&s);
+    _exit(0);
+}
+
+int test_case_23() {
+    ringbuffer_shm_t p, c, c2;
+    char name[64];
+    uint8_t buf[53];
+    size_t sent = 0, i = 0, n = 0, got = 0;
+    int status = -1, alive0 = -1, alive1 = -1, alive2 = -1, busy = 0, bad = 0, res = 1;
+    pid_t pid;
+
+    printf("TEST CASE #23 :: NAME = SHM_IPC\n");
+
+    /* named region, two mappings in one process: different addresses */
+    snprintf(name, sizeof(name), "/ringbuf_test_%d", (int)getpid());
+    res = res && ringbuffer_shm_create(&p, name, 100, RINGBUF_SHM_PRODUCER) == 0;
+    res = res && ringbuffer_shm_attach(&c, name, RINGBUF_SHM_CONSUMER) == 0;
+    busy = ringbuffer_shm_attach(&c2, name, RINGBUF_SHM_CONSUMER) < 0 && errno == EBUSY;
+    ringbuffer_shm_unlink(name);
+    res = res && p.rb != c.rb && p.rb->data_size == 128;
+    for(i = 0; res && i < 10; i++) {
+        memset(buf, 'a' + i, sizeof(buf));
+        res = res && ringbuffer_write(p.rb, buf, 50) == 50;
+        res = res && ringbuffer_read(c.rb, buf, sizeof(buf)) == 50 && buf[0] == 'a' + i && buf[49] == 'a' + i;
+    }
+    ringbuffer_shm_detach(&c);
+    ringbuffer_shm_detach(&p);
+
+    /* memfd region, consumer in a child */
+    res = res && ringbuffer_shm_create(&p, 0, 4096, RINGBUF_SHM_PRODUCER) == 0;
+    alive0 = ringbuffer_shm_peer_alive(&p);
+    pid = fork();
+    if( !pid ) test_case_23_child(p.fd, 0);
+    while( !p.hdr->pid[RINGBUF_SHM_CONSUMER] ) sched_yield();
+    alive1 = ringbuffer_shm_peer_alive(&p);
+    while( sent < TEST_SHM_BYTES ) {
+        size_t len = (sent * 7) % sizeof(buf) + 1;
+        if( len > TEST_SHM_BYTES - sent ) len = TEST_SHM_BYTES - sent;
+        for(i = 0; i < len; i++) buf[i] = (uint8_t)((sent + i) % 251);
+        n = ringbuffer_write(p.rb, buf, len);
+        if( !n ) sched_yield();
+        sent += n;
+    }
+    waitpid(pid, &status, 0);
+    res = res && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    res = res && ringbuffer_shm_peer_alive(&p) == 0;
+
+    /* consumer dies attached: the slot is taken over */
+    pid = fork();
+    if( !pid ) test_case_23_child(p.fd, 1);
+    waitpid(pid, &status, 0);
+    alive2 = ringbuffer_shm_peer_alive(&p);
+    ringbuffer_write(p.rb, (const uint8_t*)"after", 5);
+    res = res && ringbuffer_shm_attach_fd(&c, p.fd, RINGBUF_SHM_CONSUMER) == 0;
+    got = ringbuffer_read(c.rb, buf, sizeof(buf));
+    res = res && got == 5 && !memcmp(buf, "after", 5);
+    ringbuffer_shm_detach(&c);
+    ringbuffer_shm_detach(&p);
+
+    /* layout from another version */
+    res = res && ringbuffer_shm_create(&p, 0, 64, RINGBUF_SHM_PRODUCER) == 0;
+    p.hdr->version = RINGBUF_SHM_VERSION + 1;
+    bad = ringbuffer_shm_attach_fd(&c, p.fd, RINGBUF_SHM_CONSUMER) < 0 && errno == EPROTO;
+    p.hdr->version = RINGBUF_SHM_VERSION;
+    /* a peer built with another ringbuffer_t, e.g. RINGBUF_STATS */
+    p.hdr->layout.stats ^= 1;
+    p.hdr->layout.rcount_off += 8;
+    bad = bad && ringbuffer_shm_attach_fd(&c, p.fd, RINGBUF_SHM_CONSUMER) < 0 && errno == EPROTO;
+    p.hdr->layout.stats ^= 1;
+    p.hdr->layout.rcount_off -= 8;
+    bad = bad && ringbuffer_shm_attach_fd(&c, p.fd, RINGBUF_SHM_CONSUMER) == 0;
+    ringbuffer_shm_detach(&c);
+    ringbuffer_shm_detach(&p);
+
+    printf("TEST CASE #23 :: LOG = sent: %d, alive: %d %d %d, busy: %d, bad: %d, got: %d\n",
+           sent, alive0, alive1, alive2, busy, bad, got);
+
+    if( res && alive0 == 0 && alive1 == 1 && alive2 == 0 && busy && bad ) {
+        printf("TEST CASE #23 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #23 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+typedef struct test_sample_t_ {
+    uint32_t seq;
+    int16_t  v[3];
+} test_sample_t;
+
+RINGBUF_DEFINE(test_bytes, uint8_t, 16)
+RINGBUF_DEFINE(test_samples, test_sample_t, 8)
+RINGBUF_DEFINE(test_ptrs, test_sample_t*, 4)
+
+int test_case_24() {
+    static test_bytes_t b;
+    static test_samples_t s;
+    static test_ptrs_t p;
+    test_sample_t in[5], out[5], *ptr = 0;
+    uint8_t tmp[20];
+    size_t i = 0, w1 = 0, w2 = 0, r1 = 0, seq = 0;
+    int res = 1;
+
+    printf("TEST CASE #24 :: NAME = STATIC_TYPED_RING\n");
+
+    test_bytes_init(&b);
+    test_samples_init(&s);
+    test_ptrs_init(&p);
+
+    /* bytes: short write when full, wrap */
+    w1 = test_bytes_write(&b, (const uint8_t*)"0123456789ABCDEFGHIJ", 20);
+    r1 = test_bytes_read(&b, tmp, 10);
+    res = res && !memcmp(tmp, "0123456789", 10);
+    w2 = test_bytes_write(&b, (const uint8_t*)"abcdefghij", 10);
+    res = res && test_bytes_read(&b, tmp, sizeof(tmp)) == 16 && !memcmp(tmp, "ABCDEFabcdefghij", 16);
+    res = res && test_bytes_push(&b, 'x') && test_bytes_pop(&b, &tmp[0]) && tmp[0] == 'x' && !test_bytes_pop(&b, &tmp[0]);
+
+    /* structs in element units, across the wrap several times */
+    for(i = 0; res && i < 20; i++) {
+        size_t k = 0;
+        for(k = 0; k < 5; k++) {
+            in[k].seq = (uint32_t)(seq + k);
+            in[k].v[0] = in[k].v[1] = in[k].v[2] = (int16_t)-(int)(seq + k);
+        }
+        res = res && test_samples_write(&s, in, 5) == 5 && test_samples_write_avail(&s) == 3;
+        res = res && test_samples_peek(&s)->seq == seq;
+        res = res && test_samples_read(&s, out, 5) == 5 && !memcmp(in, out, sizeof(in));
+        seq += 5;
+    }
+
+    /* pointers */
+    for(i = 0; i < 5; i++) {
+        if( !test_ptrs_push(&p, &in[i]) ) break;
+    }
+    res = res && i == 4 && test_ptrs_read_avail(&p) == 4;
+    res = res && test_ptrs_pop(&p, &ptr) && ptr == &in[0];
+
+    printf("TEST CASE #24 :: LOG = w1: %d, r1: %d, w2: %d, seq: %d\n", w1, r1, w2, seq);
+
+    if( res && w1 == 16 && r1 == 10 && w2 == 10 && seq == 100 ) {
+        printf("TEST CASE #24 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #24 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_25() {
+    static const uint8_t modes[] = { 0, RINGBUF_MODE_SPSC, RINGBUF_MODE_POW2, RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2 };
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(32)];
+    uint8_t src[24], dst[24];
+    size_t m = 0, i = 0, n = 0, puts = 0, bad = 0;
+    int c = 0;
+
+    printf("TEST CASE #25 :: NAME = PUTC_GETC_SMALL_COPY\n");
+
+    for(i = 0; i < sizeof(src); i++) src[i] = (uint8_t)(0x30 + i);
+
+    for(m = 0; m < sizeof(modes); m++) {
+        rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, modes[m]);
+
+        /* fill until full, drain until empty */
+        while( ringbuffer_putc(rb, (uint8_t)puts) ) puts++;
+        if( ringbuffer_read_avail(rb) != rb->data_size ) bad++;
+        for(i = 0; (c = ringbuffer_getc(rb)) >= 0; i++) {
+            if( c != (uint8_t)(puts - rb->data_size + i) ) bad++;
+        }
+        if( i != rb->data_size ) bad++;
+
+        /* every small size, at every offset across `be` */
+        for(n = 1; n <= sizeof(src); n++) {
+            for(i = 0; i < rb->data_size; i++) {
+                memset(dst, 0, sizeof(dst));
+                if( ringbuffer_write(rb, src, n) != n ) bad++;
+                if( ringbuffer_read(rb, dst, n) != n || memcmp(src, dst, n) || (n < sizeof(dst) && dst[n]) ) bad++;
+                ringbuffer_putc(rb, 'x');
+                ringbuffer_getc(rb);
+            }
+        }
+    }
+
+    /* overwrite keeps the newest bytes */
+    rb = ringbuffer_alloc(RINGBUF_ALLOC_SIZE(4), databuf);
+    ringbuffer_update_flags(rb, 1, RINGBUF_OVERWRITE);
+    for(i = 0; i < 6; i++) ringbuffer_putc(rb, (uint8_t)('a' + i));
+    n = ringbuffer_read(rb, dst, sizeof(dst));
+
+    printf("TEST CASE #25 :: LOG = puts: %d, bad: %d, overwrite: %.*s, overrun: %d\n",
+           puts, bad, (int)n, dst, ringbuffer_overrun(rb));
+
+    if( !bad && n == 4 && !memcmp(dst, "cdef", 4) && ringbuffer_overrun(rb) == 2 ) {
+        printf("TEST CASE #25 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #25 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_26() {
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(16)];
+    uint8_t tmp[16] = { 0 };
+    ringbuffer_stats_t st;
+    int ok = 0;
+
+    printf("TEST CASE #26 :: NAME = STATS\n");
+
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+    ringbuffer_update_flags(rb, 0, RINGBUF_AUTOCOMMIT);
+
+    ringbuffer_write(rb, tmp, 10);
+    ringbuffer_commit(rb);
+    ringbuffer_write(rb, tmp, 10);      /* short, 6 of 10 */
+    ringbuffer_rollback(rb);
+    ringbuffer_read(rb, tmp, 8);
+    ringbuffer_write(rb, tmp, 12);      /* crosses be */
+    ringbuffer_commit(rb);
+    while( ringbuffer_putc(rb, 'x') );  /* 2 fit, the third is short */
+    ringbuffer_rollback(rb);
+
+    ringbuffer_stats(rb, &st);
+
+    printf("TEST CASE #26 :: LOG = written: %d, read: %d, short: %d, commits: %d, rollbacks: %d, hwm: %d, wraps: %d\n",
+           st.written, st.read, st.short_writes, st.commits, st.rollbacks, st.hwm, st.wraps);
+
+#ifdef RINGBUF_STATS
+    ok = st.written == 22 && st.read == 8 && st.short_writes == 2 && st.commits == 2
+      && st.rollbacks == 2 && st.hwm == 14 && st.wraps == 2;
+#else
+    ok = !st.written && !st.read && !st.short_writes && !st.commits
+      && !st.rollbacks && !st.hwm && !st.wraps;
+#endif
+
+    if( ok ) {
+        printf("TEST CASE #26 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #26 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_27() {
+    ringbuffer_t *rb;
+    ringbuffer_savepoint_t sp;
+    uint8_t src[300], dst[300];
+    size_t i = 0, w0 = 0, w1 = 0, w2 = 0, r0 = 0, r1 = 0, sz0 = 0, sz1 = 0, sz2 = 0, sz3 = 0;
+    int shrink = 0, fixed = 0, res = 1;
+
+    printf("TEST CASE #27 :: NAME = HEAP_RESIZE\n");
+
+    for(i = 0; i < sizeof(src); i++) src[i] = (uint8_t)('A' + i % 26);
+
+    /* STATE_1 (wrapped) layout plus an open transaction survive a resize */
+    rb = ringbuffer_new(16, 0);
+    ringbuffer_write(rb, src, 10);
+    ringbuffer_read(rb, dst, 6);
+    ringbuffer_update_flags(rb, 0, RINGBUF_AUTOCOMMIT);
+    ringbuffer_write(rb, src + 10, 10);
+    ringbuffer_commit(rb);
+    ringbuffer_write(rb, src + 20, 2);
+    shrink = ringbuffer_resize(rb, 8) < 0;
+    res = res && ringbuffer_resize(rb, 40) == 0 && rb->data_size == 40;
+    ringbuffer_commit(rb);
+    r0 = ringbuffer_read(rb, dst, sizeof(dst));
+    res = res && r0 == 16 && !memcmp(dst, src + 6, 16);
+
+    /* auto-grow with a transaction and a savepoint across the growth */
+    ringbuffer_autogrow(rb, 100);
+    w0 = ringbuffer_write(rb, src, 30);
+    ringbuffer_savepoint(rb, &sp);
+    w1 = ringbuffer_write(rb, src + 30, 50);
+    sz0 = rb->data_size;
+    ringbuffer_rollback_to(rb, &sp);
+    ringbuffer_commit(rb);
+    r1 = ringbuffer_read(rb, dst, sizeof(dst));
+    res = res && r1 == 30 && !memcmp(dst, src, 30);
+    ringbuffer_update_flags(rb, 1, RINGBUF_AUTOCOMMIT);
+    w2 = ringbuffer_write(rb, src, 150);
+    sz1 = rb->data_size;
+    res = res && ringbuffer_read(rb, dst, sizeof(dst)) == 100 && !memcmp(dst, src, 100);
+    ringbuffer_free(rb);
+
+    /* POW2 doubles within the ceiling */
+    rb = ringbuffer_new(10, RINGBUF_MODE_POW2);
+    ringbuffer_autogrow(rb, 200);
+    ringbuffer_write(rb, src, 100);
+    sz2 = rb->data_size;
+    res = res && ringbuffer_read(rb, dst, sizeof(dst)) == 100 && !memcmp(dst, src, 100);
+    ringbuffer_free(rb);
+
+    /* small writes that take "all free space" grow only as needed */
+    {
+        ringbuffer_span_t span[2];
+        int fds[2];
+        rb = ringbuffer_new(64, 0);
+        ringbuffer_autogrow(rb, 1 << 20);
+        res = res && ringbuffer_msg_write(rb, src, 2) == 2 && rb->data_size == 64;
+        res = res && ringbuffer_write_reserve(rb, SIZE_MAX, span) == 61 && rb->data_size == 64;
+        res = res && ringbuffer_msg_write(rb, src, 100) == 100 && rb->data_size == 128;
+        res = res && pipe(fds) == 0 && write(fds[1], "abc", 3) == 3;
+        res = res && ringbuffer_fill_from_fd(rb, fds[0]) == 3;
+        sz3 = rb->data_size;
+        close(fds[0]);
+        close(fds[1]);
+        ringbuffer_free(rb);
+    }
+
+    /* only heap buffers */
+    {
+        static uint8_t databuf[RINGBUF_ALLOC_SIZE(16)];
+        rb = ringbuffer_alloc(sizeof(databuf), databuf);
+        fixed = ringbuffer_resize(rb, 32) < 0 && ringbuffer_autogrow(rb, 32) < 0
+             && !ringbuffer_new(16, RINGBUF_MODE_SPSC);
+    }
+
+    printf("TEST CASE #27 :: LOG = r0: %d, w: %d %d %d, r1: %d, size: %d %d %d %d, shrink: %d, fixed: %d\n",
+           r0, w0, w1, w2, r1, sz0, sz1, sz2, sz3, shrink, fixed);
+
+    if( res && shrink && fixed && w0 == 30 && w1 == 50 && w2 == 100
+        && sz0 == 80 && sz1 == 100 && sz2 == 128 && sz3 == 104 + RINGBUF_FD_CHUNK ) {
+        printf("TEST CASE #27 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #27 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_28() {
+    static const uint8_t modes[] = { 0, RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2 };
+    static const char *lines[] = { "GET / HTTP/1.1\n", "Host: x\n", "\n", "a-rather-long-header: 0123\n" };
+    ringbuffer_t *rb;
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(32)];
+    ringbuffer_span_t span[2];
+    char line[64];
+    size_t m = 0, i = 0, k = 0, n = 0, wraps = 0, bad = 0, npos0 = 0, npos1 = 0;
+
+    printf("TEST CASE #28 :: NAME = FIND_READ_UNTIL\n");
+
+    for(m = 0; m < sizeof(modes); m++) {
+        rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, modes[m]);
+        npos0 = ringbuffer_find(rb, '\n');
+
+        for(i = 0; i < 40; i++) {
+            const char *l = lines[i % 4];
+            size_t len = strlen(l);
+            /* split the line in two writes, the first one has no delimiter */
+            ringbuffer_write(rb, (const uint8_t*)l, len / 2);
+            if( len / 2 && ringbuffer_read_until(rb, '\n', span) ) bad++;
+            ringbuffer_write(rb, (const uint8_t*)l + len / 2, len - len / 2);
+
+            if( ringbuffer_find(rb, '\n') != len - 1 ) bad++;
+            n = ringbuffer_read_until(rb, '\n', span);
+            if( span[1].len ) wraps++;
+            for(k = 0; k < span[0].len; k++) line[k] = (char)span[0].ptr[k];
+            for(k = 0; k < span[1].len; k++) line[span[0].len + k] = (char)span[1].ptr[k];
+            if( n != len || memcmp(line, l, len) ) bad++;
+            ringbuffer_read_consume(rb, n);
+        }
+        npos1 = ringbuffer_find(rb, '\n');
+    }
+
+    printf("TEST CASE #28 :: LOG = bad: %d, wrapped lines: %d, npos: %d %d\n",
+           bad, wraps, npos0 == RINGBUF_NPOS, npos1 == RINGBUF_NPOS);
+
+    if( !bad && wraps && npos0 == RINGBUF_NPOS && npos1 == RINGBUF_NPOS ) {
+        printf("TEST CASE #28 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #28 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+FSM_DECLARE(test_kv, KV_KEY)
+    FSM_STATE_DECL(KV_VALUE)
+    FSM_STATE_DECL(KV_ESC)
+FSM_CTX_DECLARE_END(test_kv, 2)
+
+typedef struct test_kv_t_ {
+    test_kv__ctx__t fsm;
+    ringbuffer_t    *rb;
+    uint8_t         databuf[RINGBUF_ALLOC_SIZE(8)];
+    size_t          fed;
+    size_t          keys, values, records;
+} test_kv_t;
+
+/* key=value; records, '\\' escapes one byte, '.' ends the input */
+static void test_kv_run(test_kv_t *p) {
+    int c = 0;
+    FSM_CTX_RUN(test_kv, &p->fsm)
+
+        FSM_STATE_BEGIN(KV_KEY)
+            FSM_CTX_GETC(p->rb, c)
+            if( c == '\\' ) {
+                FSM_CTX_STACK_PUSH(FSM_CURRENT_STATE);
+                FSM_TRANS(FSM_S(KV_ESC));
+            } else if( c == '=' ) {
+                FSM_TRANS(FSM_S(KV_VALUE));
+            } else if( c == '.' ) {
+                FSM_TRANS(FSM_FINAL_STATE);
+            } else {
+                p->keys++;
+            }
+        FSM_STATE_END(FSM_CURRENT_STATE)
+
+        FSM_STATE_BEGIN(KV_VALUE)
+            FSM_CTX_GETC(p->rb, c)
+            if( c == '\\' ) {
+                FSM_CTX_STACK_PUSH(FSM_CURRENT_STATE);
+                FSM_TRANS(FSM_S(KV_ESC));
+            } else if( c == ';' ) {
+                p->records++;
+                FSM_TRANS(FSM_S(KV_KEY));
+            } else {
+                p->values++;
+            }
+        FSM_STATE_END(FSM_CURRENT_STATE)
+
+        FSM_STATE_BEGIN(KV_ESC)
+            FSM_CTX_GETC(p->rb, c)
+            FSM_TRANS(FSM_CTX_STACK_POP());
+            if( FSM_CURRENT_STATE == FSM_S(KV_KEY) ) p->keys++; else p->values++;
+        FSM_STATE_END(FSM_CURRENT_STATE)
+
+    FSM_CTX_RUN_END(test_kv)
+}
+
+#define TEST_KV_N 200
+
+int test_case_29() {
+    static const char input[] = "ab=cd;e\\=f=g\\;h;.";
+    static test_kv_t kv[TEST_KV_N];
+    size_t i = 0, done = 0, rounds = 0, bad = 0;
+
+    printf("TEST CASE #29 :: NAME = FSM_CTX_INSTANCES\n");
+
+    for(i = 0; i < TEST_KV_N; i++) {
+        memset(&kv[i], 0, sizeof(kv[i]));
+        FSM_CTX_INIT(&kv[i].fsm);
+        kv[i].rb = ringbuffer_alloc(sizeof(kv[i].databuf), kv[i].databuf);
+    }
+
+    /* round robin, a few bytes per parser per round */
+    while( done < TEST_KV_N ) {
+        rounds++;
+        done = 0;
+        for(i = 0; i < TEST_KV_N; i++) {
+            size_t left = sizeof(input) - 1 - kv[i].fed;
+            size_t n = (size_t)(rand() % 4);
+            kv[i].fed += ringbuffer_write(kv[i].rb, (const uint8_t*)input + kv[i].fed, n < left ? n : left);
+            test_kv_run(&kv[i]);
+            done += FSM_CTX_DONE(test_kv, &kv[i].fsm);
+        }
+    }
+
+    for(i = 0; i < TEST_KV_N; i++) {
+        if( kv[i].keys != 5 || kv[i].values != 5 || kv[i].records != 2 || kv[i].fsm.sp ) bad++;
+    }
+
+    printf("TEST CASE #29 :: LOG = parsers: %d, rounds: %d, bad: %d, keys: %d, values: %d, records: %d\n",
+           TEST_KV_N, rounds, bad, kv[0].keys, kv[0].values, kv[0].records);
+
+    if( !bad && rounds > 2 ) {
+        printf("TEST CASE #29 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #29 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_HDR_STATES(X) X(HDR_LINE) X(HDR_NAME) X(HDR_VALUE) X(HDR_ESC) X(HDR_LF) X(HDR_END)
+
+FSM_SPAN_DECLARE(test_hdr, TEST_HDR_STATES, 2)
+
+typedef struct test_hdr_t_ {
+    test_hdr__ctx__t fsm;
+    size_t           headers, messages, escapes;
+} test_hdr_t;
+
+/* "Name: value\r\n" lines, an empty line ends a message, '\\' escapes a
+   byte in a value, '.' at a line start ends the input */
+static size_t test_hdr_feed(test_hdr_t *h, const uint8_t *p, size_t len) {
+    size_t used = 0;
+    FSM_SPAN_BEGIN(test_hdr, TEST_HDR_STATES, &h->fsm, p, len)
+
+        FSM_SPAN_STATE(HDR_LINE)
+            if( FSM_SPAN_BYTE == '\r' ) FSM_SPAN_GOTO(HDR_END);
+            if( FSM_SPAN_BYTE == '.' ) FSM_SPAN_FINAL();
+            FSM_SPAN_GOTO(HDR_NAME);
+
+        FSM_SPAN_STATE(HDR_NAME)
+            if( FSM_SPAN_BYTE == ':' ) FSM_SPAN_GOTO(HDR_VALUE);
+            FSM_SPAN_GOTO(HDR_NAME);
+
+        FSM_SPAN_STATE(HDR_VALUE)
+            if( FSM_SPAN_BYTE == '\r' ) {
+                h->headers++;
+                FSM_SPAN_GOTO(HDR_LF);
+            }
+            if( FSM_SPAN_BYTE == '\\' ) {
+                FSM_CTX_STACK_PUSH(FSM_S(HDR_VALUE));
+                FSM_SPAN_GOTO(HDR_ESC);
+            }
+            FSM_SPAN_GOTO(HDR_VALUE);
+
+        FSM_SPAN_STATE(HDR_ESC)
+            h->escapes++;
+            FSM_SPAN_RETURN();
+
+        FSM_SPAN_STATE(HDR_LF)
+            FSM_SPAN_GOTO(HDR_LINE);
+
+        FSM_SPAN_STATE(HDR_END)
+            h->messages++;
+            FSM_SPAN_GOTO(HDR_LINE);
+
+    FSM_SPAN_END(test_hdr, used)
+    return used;
+}
+
+int test_case_30() {
+    static const char msg[] = "Host: a\r\nX-Esc: a\\\rb\\\\c\r\n\r\n";
+    static char input[sizeof(msg) * 50 + 8];
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(64)];
+    ringbuffer_t *rb;
+    ringbuffer_span_t span[2];
+    test_hdr_t h;
+    uint8_t rest[16] = { 0 };
+    size_t i = 0, fed = 0, len = 0, used = 0, calls = 0;
+
+    printf("TEST CASE #30 :: NAME = FSM_SPAN\n");
+
+    for(i = 0; i < 50; i++) strcat(input, msg);
+    strcat(input, ".rest");
+    len = strlen(input);
+
+    memset(&h, 0, sizeof(h));
+    FSM_CTX_INIT(&h.fsm);
+    rb = ringbuffer_alloc(sizeof(databuf), databuf);
+
+    while( !FSM_CTX_DONE(test_hdr, &h.fsm) && calls < 100000 ) {
+        size_t n = (size_t)(rand() % 40);
+        fed += ringbuffer_write(rb, (const uint8_t*)input + fed, n < len - fed ? n : len - fed);
+        ringbuffer_read_peek(rb, SIZE_MAX, span);
+        used = test_hdr_feed(&h, span[0].ptr, span[0].len);
+        if( used == span[0].len && span[1].len ) used += test_hdr_feed(&h, span[1].ptr, span[1].len);
+        ringbuffer_read_consume(rb, used);
+        calls++;
+    }
+    fed += ringbuffer_write(rb, (const uint8_t*)input + fed, len - fed);
+    ringbuffer_read(rb, rest, sizeof(rest) - 1);
+
+    printf("TEST CASE #30 :: LOG = calls: %d, headers: %d, messages: %d, escapes: %d, rest: %s\n",
+           calls, h.headers, h.messages, h.escapes, rest);
+
+    if( FSM_CTX_DONE(test_hdr, &h.fsm) && h.headers == 100 && h.messages == 50 && h.escapes == 100
+        && !h.fsm.sp && !strcmp((char*)rest, "rest") ) {
+        printf("TEST CASE #30 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #30 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_BCAST_BYTES (1024*1024)
+#define TEST_BCAST_READERS 3
+
+typedef struct test_bcast_reader_t_ {
+    ringbuffer_bcast_t *b;
+    int                id;
+    size_t             got;
+    size_t             bad;
+} test_bcast_reader_t;
+
+static void *test_bcast_reader(void *arg) {
+    test_bcast_reader_t *r = (test_bcast_reader_t*)arg;
+    uint8_t buf[97];
+    size_t i = 0, n = 0;
+    while( r->got < TEST_BCAST_BYTES ) {
+        n = ringbuffer_bcast_read(r->b, r->id, buf, 1 + (size_t)rand() % sizeof(buf));
+        if( !n ) {
+            sched_yield();
+            continue;
+        }
+        for(i = 0; i < n; i++) {
+            if( buf[i] != (uint8_t)((r->got + i) % 253) ) r->bad++;
+        }
+        r->got += n;
+    }
+    return 0;
+}
+
+int test_case_31() {
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(1024)];
+    static uint8_t src[TEST_BCAST_BYTES];
+    ringbuffer_t *rb;
+    ringbuffer_bcast_t b;
+    test_bcast_reader_t r[TEST_BCAST_READERS];
+    pthread_t th[TEST_BCAST_READERS];
+    uint8_t buf[100];
+    size_t i = 0, sent = 0, bad = 0, blocked = 0, fast = 0, lost = 0;
+    int a = 0, slow = 0, evicted = 0;
+
+    printf("TEST CASE #31 :: NAME = BROADCAST\n");
+
+    for(i = 0; i < sizeof(src); i++) src[i] = (uint8_t)(i % 253);
+
+    /* every reader sees every byte, written once */
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2);
+    ringbuffer_bcast_init(&b, rb, 0);
+    for(i = 0; i < TEST_BCAST_READERS; i++) {
+        r[i].b = &b;
+        r[i].id = ringbuffer_bcast_join(&b);
+        r[i].got = r[i].bad = 0;
+        pthread_create(&th[i], 0, test_bcast_reader, &r[i]);
+    }
+    while( sent < sizeof(src) ) {
+        size_t n = ringbuffer_bcast_write(&b, src + sent, 1 + (sizeof(src) - sent - 1) % 61);
+        if( !n ) sched_yield();
+        sent += n;
+    }
+    for(i = 0; i < TEST_BCAST_READERS; i++) {
+        pthread_join(th[i], 0);
+        bad += r[i].bad + (r[i].got != TEST_BCAST_BYTES) + (r[i].id != (int)i);
+    }
+
+    /* the slowest reader gates the producer */
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2);
+    ringbuffer_bcast_init(&b, rb, 0);
+    a = ringbuffer_bcast_join(&b);
+    slow = ringbuffer_bcast_join(&b);
+    for(i = 0; i < 20; i++) {
+        if( ringbuffer_bcast_write(&b, src, 100) != 100 ) blocked++;
+        fast += ringbuffer_bcast_read(&b, a, buf, sizeof(buf));
+    }
+
+    /* ... unless it lags by more than lag_max */
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC | RINGBUF_MODE_POW2);
+    ringbuffer_bcast_init(&b, rb, 512);
+    a = ringbuffer_bcast_join(&b);
+    slow = ringbuffer_bcast_join(&b);
+    for(i = 0; i < 20; i++) {
+        if( ringbuffer_bcast_write(&b, src, 100) != 100 ) lost++;
+        ringbuffer_bcast_read(&b, a, buf, sizeof(buf));
+    }
+    evicted = ringbuffer_bcast_evicted(&b, slow) && !ringbuffer_bcast_read(&b, slow, buf, sizeof(buf))
+           && !ringbuffer_bcast_evicted(&b, a);
+    ringbuffer_bcast_leave(&b, slow);
+    evicted = evicted && ringbuffer_bcast_join(&b) == slow;
+
+    printf("TEST CASE #31 :: LOG = readers: %d, bad: %d, blocked: %d, fast: %d, lost: %d, evicted: %d\n",
+           TEST_BCAST_READERS, bad, blocked, fast, lost, evicted);
+
+    if( !bad && blocked == 10 && fast == 1024 && !lost && evicted ) {
+        printf("TEST CASE #31 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #31 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+#define TEST_SPILL_BYTES (4*1024*1024)
+
+static void *test_spill_consumer(void *arg) {
+    ringbuffer_spill_t *s = (ringbuffer_spill_t*)arg;
+    static uint8_t buf[3000];
+    size_t got = 0, i = 0, n = 0, bad = 0;
+    while( got < TEST_SPILL_BYTES ) {
+        n = ringbuffer_spill_read(s, buf, 1 + (size_t)rand() % sizeof(buf));
+        if( !n || rand() % 64 == 0 ) sched_yield();
+        for(i = 0; i < n; i++) {
+            if( buf[i] != (uint8_t)((got + i) % 241) ) bad++;
+        }
+        got += n;
+    }
+    return (void*)bad;
+}
+
+int test_case_32() {
+    static uint8_t databuf[RINGBUF_ALLOC_SIZE(256)];
+    static uint8_t src[TEST_SPILL_BYTES];
+    static uint8_t dst[20000];
+    ringbuffer_t *rb;
+    ringbuffer_spill_t s;
+    pthread_t th;
+    void *tbad = 0;
+    size_t i = 0, w0 = 0, r0 = 0, w1 = 0, w2 = 0, sent = 0, bad = 0;
+    uint64_t pend0 = 0, pend1 = 0, pend2 = 0;
+    int res = 1;
+
+    printf("TEST CASE #32 :: NAME = SPILL\n");
+
+    for(i = 0; i < sizeof(src); i++) src[i] = (uint8_t)(i % 241);
+
+    /* burst into a stalled reader: 256 bytes in the ring, the rest on disk */
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC);
+    res = res && ringbuffer_spill_init(&s, rb, "/tmp", 4096, 1024*1024) == 0;
+    for(i = 0; i < 20000; i += 100) w0 += ringbuffer_spill_write(&s, src + i, 100);
+    pend0 = ringbuffer_spill_pending(&s);
+    while( (i = ringbuffer_spill_read(&s, dst + r0, sizeof(dst) - r0)) ) r0 += i;
+    res = res && r0 == 20000 && !memcmp(dst, src, 20000);
+    pend1 = ringbuffer_spill_pending(&s);
+
+    /* drained: back to memory only */
+    w1 = ringbuffer_spill_write(&s, src, 100);
+    res = res && ringbuffer_read_avail(rb) == 100 && !s.spilling;
+    ringbuffer_spill_read(&s, dst, sizeof(dst));
+
+    /* bounded by spill_max */
+    for(i = 0; i < 20; i++) w2 += ringbuffer_spill_write(&s, src, 100*1024);
+    pend2 = ringbuffer_spill_pending(&s);
+    ringbuffer_spill_destroy(&s);
+
+    /* producer and consumer threads */
+    rb = ringbuffer_alloc_mode(sizeof(databuf), databuf, RINGBUF_MODE_SPSC);
+    res = res && ringbuffer_spill_init(&s, rb, "/tmp", 64*1024, 64*1024*1024) == 0;
+    pthread_create(&th, 0, test_spill_consumer, &s);
+    while( sent < sizeof(src) ) {
+        size_t n = 1 + (size_t)rand() % 5000;
+        if( n > sizeof(src) - sent ) n = sizeof(src) - sent;
+        sent += ringbuffer_spill_write(&s, src + sent, n);
+    }
+    pthread_join(th, &tbad);
+    bad = (size_t)tbad;
+    ringbuffer_spill_destroy(&s);
+
+    /* a failed init leaves nothing to close */
+    res = res && ringbuffer_spill_init(&s, rb, "/tmp", 0, 1) < 0 && s.fd == -1;
+    ringbuffer_spill_destroy(&s);
+
+    printf("TEST CASE #32 :: LOG = w0: %d, pending: %d, r0: %d, pending: %d, w1: %d, w2: %d, pending: %d, thread bad: %d\n",
+           w0, (size_t)pend0, r0, (size_t)pend1, w1, w2, (size_t)pend2, bad);
+
+    if( res && w0 == 20000 && pend0 == 20000 - 256 && pend1 == 0 && w1 == 100
+        && w2 == 256 + 1024*1024 && pend2 == 1024*1024 && !bad ) {
+        printf("TEST CASE #32 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #32 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+
+static void test_case_33_child(const char *path) {
+    ringbuffer_shm_t p;
+    uint8_t buf[100];
+    if( ringbuffer_shm_open_file(&p, path, 256, RINGBUF_SHM_PRODUCER) < 0 ) _exit(1);
+    memset(buf, 'A', sizeof(buf));
+    ringbuffer_write(p.rb, buf, 100);
+    if( ringbuffer_shm_sync(&p) < 0 ) _exit(1);
+    memset(buf, 'B', sizeof(buf));
+    ringbuffer_write(p.rb, buf, 50);
+    /* not committed when it dies */
+    memset(buf, 'C', sizeof(buf));
+    ringbuffer_write_batch_begin(p.rb);
+    ringbuffer_write(p.rb, buf, 10);
+    _exit(0);
+}
+
+int test_case_33() {
+    ringbuffer_shm_t p, c;
+    char path[64];
+    uint8_t buf[256];
+    size_t got0 = 0, got1 = 0, got2 = 0, i = 0;
+    int status = 0, res = 1, a = 0, b = 0, d = 0, foreign = 0;
+    pid_t pid = 0;
+
+    printf("TEST CASE #33 :: NAME = PERSISTENT_FILE\n");
+
+    snprintf(path, sizeof(path), "/tmp/ringbuf_test_persist_%d", (int)getpid());
+    unlink(path);
+
+    /* the producer crashes, same boot: the committed data is there */
+    pid = fork();
+    if( !pid ) test_case_33_child(path);
+    waitpid(pid, &status, 0);
+    res = res && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    res = res && ringbuffer_shm_open_file(&c, path, 0, RINGBUF_SHM_CONSUMER) == 0;
+    res = res && c.rb->data_size == 256;
+    ringbuffer_read_batch_begin(c.rb);
+    got0 = ringbuffer_read(c.rb, buf, 100);
+    res = res && ringbuffer_shm_sync(&c) == 0;
+    ringbuffer_read_batch_end(c.rb);
+    got0 += ringbuffer_read(c.rb, buf + 100, sizeof(buf) - 100);
+    for(i = 0; i < got0; i++) a += buf[i] == 'A', b += buf[i] == 'B';
+    res = res && a == 100 && b == 50;
+
+    /* a new producer takes the dead one's slot */
+    res = res && ringbuffer_shm_open_file(&p, path, 0, RINGBUF_SHM_PRODUCER) == 0;
+    memset(buf, 'D', 20);
+    res = res && ringbuffer_write(p.rb, buf, 20) == 20;
+    res = res && ringbuffer_shm_sync(&p) == 0;
+    got1 = ringbuffer_read(c.rb, buf, sizeof(buf));
+
+    /* reboot: back to the last synced counters, the unsynced read of B
+       and the read of D are replayed */
+    p.hdr->boot_id[0] ^= 1;
+    ringbuffer_shm_detach(&p);
+    ringbuffer_shm_detach(&c);
+    res = res && ringbuffer_shm_open_file(&c, path, 0, RINGBUF_SHM_CONSUMER) == 0;
+    got2 = ringbuffer_read(c.rb, buf, sizeof(buf));
+    a = b = 0;
+    for(i = 0; i < got2; i++) a += buf[i] == 'A', b += buf[i] == 'B', d += buf[i] == 'D';
+    res = res && got2 == 70 && b == 50 && d == 20 && !memcmp(buf + 50, "DDDD", 4);
+
+    /* the file as a build with another ringbuffer_t left it */
+    c.hdr->layout.rb_size += 64;
+    ringbuffer_shm_detach(&c);
+    foreign = ringbuffer_shm_open_file(&c, path, 0, RINGBUF_SHM_CONSUMER) < 0 && errno == EPROTO;
+    unlink(path);
+
+    printf("TEST CASE #33 :: LOG = got: %d %d %d, replay A: %d, B: %d, D: %d, foreign: %d\n",
+           got0, got1, got2, a, b, d, foreign);
+
+    if( res && got0 == 150 && got1 == 20 && a == 0 && foreign ) {
+        printf("TEST CASE #33 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #33 :: RESULT = FAIL\n");
+    return (-1);
+}
+
+int test_case_34() {
+    _Alignas(ringbuffer_t) static uint8_t databuf[RINGBUF_ALLOC_SIZE(16) + 64];
+    uint8_t buf[32];
+    size_t off = 0, bad = 0;
+    int res = 1;
+
+    printf("TEST CASE #34 :: NAME = ALLOC_ALIGNMENT\n");
+
+    /* the capacity is what was asked for wherever the array starts.
+       Without RINGBUF_CACHELINE the caller aligns the array */
+    for(off = 0; off < 64; off += RINGBUF_ALLOC_SLACK ? 1 : _Alignof(ringbuffer_t)) {
+        ringbuffer_t *rb = ringbuffer_alloc(RINGBUF_ALLOC_SIZE(16), databuf + off);
+        memset(buf, 'x', sizeof(buf));
+        if( !rb || rb->data_size != 16 || ringbuffer_write(rb, buf, sizeof(buf)) != 16
+            || rb->be > databuf + off + RINGBUF_ALLOC_SIZE(16) ) {
+            bad++;
+        }
+    }
+    res = res && !ringbuffer_alloc(RINGBUF_ALLOC_SIZE(0), databuf);
+
+    printf("TEST CASE #34 :: LOG = bad offsets: %d\n", bad);
+
+    if( res && !bad ) {
+        printf("TEST CASE #34 :: RESULT = PASS\n");
+        return 0;
+    }
+    printf("TEST CASE #34 :: RESULT = FAIL\n");
+    return (-1);
+}
+
 
 int main(void) {
 
@@ -688,6 +2343,30 @@ int main(void) {
     test_case_8();
     test_case_9();
     test_case_10();
+    test_case_11();
+    test_case_12();
+    test_case_13();
+    test_case_14();
+    test_case_15();
+    test_case_16();
+    test_case_17();
+    test_case_18();
+    test_case_19();
+    test_case_20();
+    test_case_21();
+    test_case_22();
+    test_case_23();
+    test_case_24();
+    test_case_25();
+    test_case_26();
+    test_case_27();
+    test_case_28();
+    test_case_29();
+    test_case_30();
+    test_case_31();
+    test_case_32();
+    test_case_33();
+    test_case_34();
 
     return 0;
 }